@@ -5,6 +5,7 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
 // #include <coap_server_client_interface.h>
 #include <net/coap_utils.h>
 #include <zephyr/logging/log.h>
@@ -12,10 +13,12 @@
 #include <zephyr/net/socket.h>
 #include <dk_buttons_and_leds.h>
 #include <openthread/coap.h>
+#include <openthread/ip6.h>
 #include <openthread/message.h>
 #include <openthread/thread.h>
 
 #include "coap_client_utils.h"
+#include "sensor_registry.h"
 
 // LOG_MODULE_REGISTER(coap_client_utils, CONFIG_COAP_CLIENT_UTILS_LOG_LEVEL);
 LOG_MODULE_REGISTER(coap_client_utils, LOG_LEVEL_INF);
@@ -36,6 +39,7 @@ static struct k_work_q coap_client_workq;
 
 static struct k_work unicast_light_work;
 static struct k_work multicast_light_work;
+static struct k_work sample_mesh_work;
 static struct k_work toggle_MTD_SED_work;
 static struct k_work provisioning_work;
 static struct k_work on_connect_work;
@@ -115,6 +119,18 @@ static otCoapResource light_resource = {
 	.mNext = NULL,
 };
 
+/**@brief Definition of CoAP resources for snapshot answers. */
+static otCoapResource snapshot_resource = {
+	.mUriPath = SNAPSHOT_URI_PATH,
+	.mHandler = NULL,
+	.mContext = NULL,
+	.mNext = NULL,
+};
+
+/* Last synchronized sampling trigger and the answers received to it */
+static uint16_t snapshot_seq;
+static atomic_t snapshot_answers;
+
 
 static otError provisioning_response_send(otMessage *request_message,
 					  const otMessageInfo *message_info)
@@ -214,6 +230,7 @@ static void provisioning_request_handler(void *context, otMessage *message,
 static const char *const light_option[] = { LIGHT_URI_PATH, NULL };
 static const char *const provisioning_option[] = { PROVISIONING_URI_PATH,
 						   NULL };
+static const char *const sample_option[] = { SAMPLE_URI_PATH, NULL };
 
 /* Thread multicast mesh local address */
 static struct sockaddr_in6 multicast_local_addr = {
@@ -233,6 +250,18 @@ static struct sockaddr_in6 unique_local_addr = {
 	.sin6_scope_id = 0U
 };
 
+/* Light command carried by the next acknowledgment to the peer */
+static atomic_t piggyback_command;
+/* The peer sends its readings as confirmable requests */
+static bool peer_reliable;
+
+/* Light commands target the provisioned peer only, not every sender */
+static bool is_provisioned_peer(const otIp6Address *addr)
+{
+	return memcmp(addr, &unique_local_addr.sin6_addr,
+		      sizeof(unique_local_addr.sin6_addr)) == 0;
+}
+
 static bool is_mtd_in_med_mode(otInstance *instance)
 {
 	return otThreadGetLinkMode(instance).mRxOnWhenIdle;
@@ -255,7 +284,6 @@ static void poll_period_response_set(void)
 		LOG_INF("if poll period is NULL, get a poll period: %d", poll_period);
 
 		error = otLinkSetPollPeriod(instance, RESPONSE_POLL_PERIOD);
-		otThreadSetChildTimeout(instance, RESPONSE_POLL_PERIOD);
 		__ASSERT(error == OT_ERROR_NONE, "Failed to set pool period");
 
 		LOG_INF("Poll Period: %dms set", RESPONSE_POLL_PERIOD);
@@ -301,6 +329,8 @@ static int on_provisioning_reply(const struct coap_packet *response,
 	}
 
 	memcpy(&unique_local_addr.sin6_addr, payload, payload_size);
+	peer_reliable = false;
+	atomic_clear(&piggyback_command);
 
 	if (!inet_ntop(AF_INET6, payload, unique_local_addr_str,
 		       INET6_ADDRSTRLEN)) {
@@ -333,6 +363,13 @@ static void toggle_one_light(struct k_work *item)
 		return;
 	}
 
+	if (peer_reliable) {
+		/* A sleepy peer picks it up with its next reading */
+		atomic_set(&piggyback_command, payload);
+		LOG_INF("Light command queued for the next acknowledgment");
+		return;
+	}
+
 	LOG_INF("Send 'light' request to: %s", unique_local_addr_str);
 	coap_send_request(COAP_METHOD_PUT,
 			  (const struct sockaddr *)&unique_local_addr,
@@ -355,6 +392,28 @@ static void toggle_mesh_lights(struct k_work *item)
 			  light_option, &command, sizeof(command), NULL);
 }
 
+static void sample_mesh(struct k_work *item)
+{
+	uint8_t payload[SAMPLE_TRIGGER_LEN];
+	int len;
+
+	ARG_UNUSED(item);
+
+	snapshot_seq++;
+	atomic_clear(&snapshot_answers);
+
+	len = sample_trigger_encode(payload, sizeof(payload), snapshot_seq,
+				    CONFIG_COAP_CLIENT_SYNC_NODES);
+	if (len < 0) {
+		return;
+	}
+
+	LOG_INF("Send multicast mesh 'sample' request %u", snapshot_seq);
+	coap_send_request(COAP_METHOD_PUT,
+			  (const struct sockaddr *)&multicast_local_addr,
+			  sample_option, payload, len, NULL);
+}
+
 static void send_provisioning_request(struct k_work *item)
 {
 	ARG_UNUSED(item);
@@ -477,6 +536,7 @@ void coap_client_utils_init(ot_connection_cb_t on_connect,
 	k_work_init(&on_disconnect_work, on_disconnect);
 	k_work_init(&unicast_light_work, toggle_one_light);
 	k_work_init(&multicast_light_work, toggle_mesh_lights);
+	k_work_init(&sample_mesh_work, sample_mesh);
 	k_work_init(&provisioning_work, send_provisioning_request);
 	// k_work_init(&activate_provisioning_work, activate_provisioning);
 
@@ -490,25 +550,331 @@ void coap_client_utils_init(ot_connection_cb_t on_connect,
 	}
 }
 
+static void sensor_batch_log(const otIp6Address *addr, const uint8_t *payload,
+			     uint16_t len)
+{
+	uint16_t values[SENSOR_PAYLOAD_MAX_VALUES];
+	size_t offset = SENSOR_BATCH_HDR_LEN;
+	uint8_t unit_id;
+	uint32_t age;
+	int num;
+
+	while ((num = sensor_batch_next(payload, len, &offset, &age, &unit_id,
+					values, ARRAY_SIZE(values))) >= 0) {
+		if (age == SENSOR_BATCH_AGE_UNKNOWN) {
+			LOG_INF("Stored sensor data of unit %u, age unknown",
+				unit_id);
+		} else {
+			LOG_INF("Stored sensor data of unit %u, %u ms old",
+				unit_id, age);
+			sensor_registry_put(addr, unit_id, age, values, num);
+		}
+
+		for (int i = 0; i < num; i++) {
+			LOG_INF("%d: %x;", i, values[i]);
+		}
+	}
+
+	if (num != -ENOENT) {
+		LOG_ERR("Light handler - Invalid sensor batch (%d)", num);
+	}
+}
+
+/* Reassembly of a block-wise sensor batch (RFC 7959 Block1), owned by one
+ * peer and token at a time. The slot is taken over once its owner stayed
+ * silent for longer than an exchange, EXCHANGE_LIFETIME of RFC 7252, 4.8.2.
+ */
+#define BLOCK_RX_LIFETIME_MS 247000
+
+static struct block_rx {
+	otIp6Address addr;
+	uint8_t token[OT_COAP_MAX_TOKEN_LENGTH];
+	uint8_t token_len;
+	int64_t timestamp;
+	size_t len;
+	bool active;
+	uint8_t buf[SENSOR_BATCH_TRANSFER_MAX_LEN];
+} block_rx;
+
+#define DEDUP_CACHE_SIZE 8
+/* NON_LIFETIME of RFC 7252, 4.8.2 */
+#define DEDUP_LIFETIME_MS 145000
+
+static struct dedup_entry {
+	otIp6Address addr;
+	uint16_t message_id;
+	int64_t timestamp;
+} dedup_cache[DEDUP_CACHE_SIZE];
+
+/* Retransmitted confirmable requests are answered from the response
+ * cache of OpenThread before reaching the handlers, this catches
+ * duplicated non-confirmable ones.
+ */
+static bool message_is_duplicate(otMessage *message,
+				 const otMessageInfo *message_info)
+{
+	uint16_t message_id = otCoapMessageGetMessageId(message);
+	int64_t now = k_uptime_get();
+	struct dedup_entry *oldest = &dedup_cache[0];
+
+	for (size_t i = 0; i < ARRAY_SIZE(dedup_cache); i++) {
+		struct dedup_entry *entry = &dedup_cache[i];
+
+		if (entry->timestamp != 0 &&
+		    now - entry->timestamp < DEDUP_LIFETIME_MS &&
+		    entry->message_id == message_id &&
+		    otIp6IsAddressEqual(&entry->addr,
+					&message_info->mPeerAddr)) {
+			return true;
+		}
+
+		if (entry->timestamp < oldest->timestamp) {
+			oldest = entry;
+		}
+	}
+
+	oldest->addr = message_info->mPeerAddr;
+	oldest->message_id = message_id;
+	oldest->timestamp = now;
+
+	return false;
+}
+
+static void light_response_send(otMessage *request,
+				const otMessageInfo *message_info,
+				otCoapCode code, const uint64_t *block1)
+{
+	otError error = OT_ERROR_NO_BUFS;
+	otMessage *response;
+	uint8_t command;
+
+	response = otCoapNewMessage(srv_context.ot, NULL);
+	if (response == NULL) {
+		goto end;
+	}
+
+	error = otCoapMessageInitResponse(response, request,
+					  OT_COAP_TYPE_ACKNOWLEDGMENT, code);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	if (block1 != NULL &&
+	    (code == OT_COAP_CODE_CONTINUE || code == OT_COAP_CODE_CHANGED)) {
+		error = otCoapMessageAppendUintOption(response,
+						      OT_COAP_OPTION_BLOCK1,
+						      *block1);
+		if (error != OT_ERROR_NONE) {
+			goto end;
+		}
+	}
+
+	command = code == OT_COAP_CODE_CHANGED &&
+		  is_provisioned_peer(&message_info->mPeerAddr) ?
+		  atomic_clear(&piggyback_command) : 0;
+	if (command != 0) {
+		error = otCoapMessageSetPayloadMarker(response);
+		if (error == OT_ERROR_NONE) {
+			error = otMessageAppend(response, &command,
+						sizeof(command));
+		}
+
+		if (error != OT_ERROR_NONE) {
+			atomic_set(&piggyback_command, command);
+			goto end;
+		}
+
+		LOG_INF("Piggybacked light command: %c", command);
+	}
+
+	error = otCoapSendResponse(srv_context.ot, response, message_info);
+
+end:
+	if (error != OT_ERROR_NONE && response != NULL) {
+		otMessageFree(response);
+	}
+}
+
+static bool block_rx_owner(otMessage *message,
+			   const otMessageInfo *message_info)
+{
+	uint8_t token_len = otCoapMessageGetTokenLength(message);
+
+	return block_rx.active &&
+	       otIp6IsAddressEqual(&block_rx.addr, &message_info->mPeerAddr) &&
+	       token_len == block_rx.token_len &&
+	       memcmp(block_rx.token, otCoapMessageGetToken(message),
+		      token_len) == 0;
+}
+
+static void sensor_block_receive(otMessage *message,
+				 const otMessageInfo *message_info,
+				 uint64_t block1)
+{
+	uint32_t num = block1 >> 4;
+	bool more = block1 & BIT(3);
+	size_t size = 16U << (block1 & 0x7);
+	uint16_t len = otMessageGetLength(message) - otMessageGetOffset(message);
+	int64_t now = k_uptime_get();
+	otCoapCode code;
+
+	if (otCoapMessageGetType(message) != OT_COAP_TYPE_CONFIRMABLE) {
+		LOG_ERR("Light handler - Block-wise transfer not confirmable");
+		return;
+	}
+
+	if (!block_rx_owner(message, message_info)) {
+		if (block_rx.active &&
+		    now - block_rx.timestamp < BLOCK_RX_LIFETIME_MS) {
+			/* The sender retries the batch later */
+			LOG_WRN("Light handler - Block %u refused, "
+				"reassembly busy", num);
+			light_response_send(message, message_info,
+					    OT_COAP_CODE_REQUEST_INCOMPLETE,
+					    &block1);
+			return;
+		}
+
+		if (num != 0) {
+			LOG_ERR("Light handler - Block %u out of transfer",
+				num);
+			light_response_send(message, message_info,
+					    OT_COAP_CODE_REQUEST_INCOMPLETE,
+					    &block1);
+			return;
+		}
+
+		memcpy(&block_rx.addr, &message_info->mPeerAddr,
+		       sizeof(block_rx.addr));
+		block_rx.token_len = otCoapMessageGetTokenLength(message);
+		memcpy(block_rx.token, otCoapMessageGetToken(message),
+		       block_rx.token_len);
+		block_rx.active = true;
+	}
+
+	if (num == 0) {
+		block_rx.len = 0;
+	}
+
+	block_rx.timestamp = now;
+
+	if ((size_t)num * size != block_rx.len || (more && len != size)) {
+		code = OT_COAP_CODE_REQUEST_INCOMPLETE;
+		goto respond;
+	}
+
+	if (block_rx.len + len > sizeof(block_rx.buf)) {
+		code = OT_COAP_CODE_REQUEST_TOO_LARGE;
+		goto respond;
+	}
+
+	otMessageRead(message, otMessageGetOffset(message),
+		      &block_rx.buf[block_rx.len], len);
+	block_rx.len += len;
+
+	code = more ? OT_COAP_CODE_CONTINUE : OT_COAP_CODE_CHANGED;
+
+respond:
+	light_response_send(message, message_info, code, &block1);
+
+	if (code == OT_COAP_CODE_CHANGED) {
+		LOG_INF("Received block-wise batch of %u bytes", block_rx.len);
+		sensor_batch_log(&block_rx.addr, block_rx.buf, block_rx.len);
+		block_rx.active = false;
+	} else if (code != OT_COAP_CODE_CONTINUE) {
+		LOG_ERR("Light handler - Block %u rejected", num);
+		block_rx.active = false;
+	}
+}
+
 static void light_request_handler(void *context, otMessage *message,
 				  const otMessageInfo *message_info)
 {
-	uint8_t holding_reg[50]={0};
+	uint8_t payload[MAX(SENSOR_PAYLOAD_MAX_LEN, SENSOR_BATCH_MAX_LEN)];
+	uint16_t values[SENSOR_PAYLOAD_MAX_VALUES];
+	uint16_t len;
+	otCoapOptionIterator iterator;
+	uint64_t block1;
+	uint8_t unit_id;
+	bool confirmable;
+	bool provisioned;
+	int num;
 
 	ARG_UNUSED(context);
 
-	if (otCoapMessageGetType(message) != OT_COAP_TYPE_NON_CONFIRMABLE) {
+	if (otCoapMessageGetCode(message) != OT_COAP_CODE_PUT) {
+		LOG_ERR("Light handler - Unexpected CoAP code");
+		goto end;
+	}
+
+	if (message_is_duplicate(message, message_info)) {
+		LOG_WRN("Light handler - Duplicate message 0x%04x dropped",
+			otCoapMessageGetMessageId(message));
+		goto end;
+	}
+
+	provisioned = is_provisioned_peer(&message_info->mPeerAddr);
+
+	if (otCoapOptionIteratorInit(&iterator, message) == OT_ERROR_NONE &&
+	    otCoapOptionIteratorGetFirstOptionMatching(
+		    &iterator, OT_COAP_OPTION_BLOCK1) != NULL &&
+	    otCoapOptionIteratorGetOptionUintValue(&iterator, &block1) ==
+		    OT_ERROR_NONE) {
+		if (provisioned) {
+			peer_reliable = true;
+		}
+
+		sensor_block_receive(message, message_info, block1);
+		goto end;
+	}
+
+	confirmable = otCoapMessageGetType(message) ==
+		      OT_COAP_TYPE_CONFIRMABLE;
+	if (!confirmable &&
+	    otCoapMessageGetType(message) != OT_COAP_TYPE_NON_CONFIRMABLE) {
 		LOG_ERR("Light handler - Unexpected type of message");
 		goto end;
 	}
 
-	if (otCoapMessageGetCode(message) != OT_COAP_CODE_PUT) {
-		LOG_ERR("Light handler - Unexpected CoAP code");
+	if (provisioned) {
+		peer_reliable = confirmable;
+	}
+
+	len = otMessageRead(message, otMessageGetOffset(message), payload,
+			    sizeof(payload));
+	if (otMessageGetLength(message) - otMessageGetOffset(message) != len) {
+		LOG_ERR("Light handler - Payload too long");
+		goto end;
+	}
+
+	if (len > 0 && payload[0] == SENSOR_BATCH_VERSION) {
+		sensor_batch_log(&message_info->mPeerAddr, payload, len);
+		goto ack;
+	}
+
+	num = sensor_payload_decode(payload, len, &unit_id, values,
+				    ARRAY_SIZE(values));
+	if (num < 0) {
+		LOG_ERR("Light handler - Invalid sensor payload (%d)", num);
+		if (confirmable) {
+			light_response_send(message, message_info,
+					    OT_COAP_CODE_BAD_REQUEST, NULL);
+		}
 		goto end;
 	}
-	otMessageRead(message, otMessageGetOffset(message), &holding_reg, 50);
 
-	LOG_INF("Received light request: %s", holding_reg);
+	LOG_INF("Received sensor data of unit %u", unit_id);
+	for (int i = 0; i < num; i++) {
+		LOG_INF("%d: %x;", i, values[i]);
+	}
+
+	sensor_registry_put(&message_info->mPeerAddr, unit_id, 0, values, num);
+
+ack:
+	if (confirmable) {
+		light_response_send(message, message_info,
+				    OT_COAP_CODE_CHANGED, NULL);
+	}
 
 end:
 	// if (IS_ENABLED(CONFIG_OPENTHREAD_MTD_SED)) {
@@ -517,6 +883,82 @@ end:
 	return;
 }
 
+static void snapshot_response_send(otMessage *request,
+				   const otMessageInfo *message_info)
+{
+	otError error = OT_ERROR_NO_BUFS;
+	otMessage *response;
+
+	response = otCoapNewMessage(srv_context.ot, NULL);
+	if (response == NULL) {
+		goto end;
+	}
+
+	error = otCoapMessageInitResponse(response, request,
+					  OT_COAP_TYPE_ACKNOWLEDGMENT,
+					  OT_COAP_CODE_CHANGED);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapSendResponse(srv_context.ot, response, message_info);
+
+end:
+	if (error != OT_ERROR_NONE && response != NULL) {
+		otMessageFree(response);
+	}
+}
+
+static void snapshot_request_handler(void *context, otMessage *message,
+				     const otMessageInfo *message_info)
+{
+	uint8_t payload[SENSOR_SNAPSHOT_MAX_LEN];
+	uint16_t values[SENSOR_PAYLOAD_MAX_VALUES];
+	char addr[INET6_ADDRSTRLEN];
+	uint8_t unit_id;
+	uint16_t seq;
+	uint16_t len;
+	int num;
+
+	ARG_UNUSED(context);
+
+	if (otCoapMessageGetCode(message) != OT_COAP_CODE_PUT) {
+		LOG_ERR("Snapshot handler - Unexpected CoAP code");
+		return;
+	}
+
+	if (otCoapMessageGetType(message) == OT_COAP_TYPE_CONFIRMABLE) {
+		snapshot_response_send(message, message_info);
+	}
+
+	if (message_is_duplicate(message, message_info)) {
+		return;
+	}
+
+	len = otMessageRead(message, otMessageGetOffset(message), payload,
+			    sizeof(payload));
+	num = sensor_snapshot_decode(payload, len, &seq, &unit_id, values,
+				     ARRAY_SIZE(values));
+	if (num < 0) {
+		LOG_ERR("Snapshot handler - Invalid payload (%d)", num);
+		return;
+	}
+
+	if (seq != snapshot_seq) {
+		LOG_WRN("Late answer to snapshot %u dropped", seq);
+		return;
+	}
+
+	otIp6AddressToString(&message_info->mPeerAddr, addr, sizeof(addr));
+	LOG_INF("Snapshot %u: unit %u of %s, answer %u", seq, unit_id, addr,
+		(unsigned int)atomic_inc(&snapshot_answers) + 1);
+	for (int i = 0; i < num; i++) {
+		LOG_INF("%d: %x;", i, values[i]);
+	}
+
+	sensor_registry_put(&message_info->mPeerAddr, unit_id, 0, values, num);
+}
+
 int ot_coap_init(provisioning_request_callback_t on_provisioning_request,
 		 light_request_callback_t on_light_request)
 {
@@ -553,10 +995,18 @@ int ot_coap_init(provisioning_request_callback_t on_provisioning_request,
 	light_resource.mContext = srv_context.ot;
 	light_resource.mHandler = light_request_handler;
 
+	snapshot_resource.mContext = srv_context.ot;
+	snapshot_resource.mHandler = snapshot_request_handler;
+
 	otCoapSetDefaultHandler(srv_context.ot, coap_default_handler, NULL);
 	otCoapAddResource(srv_context.ot, &light_resource);
+	otCoapAddResource(srv_context.ot, &snapshot_resource);
 	otCoapAddResource(srv_context.ot, &provisioning_resource);
 
+	if (sensor_registry_init() != 0) {
+		LOG_ERR("Failed to initialize the sensor registry");
+	}
+
 	error = otCoapStart(srv_context.ot, COAP_PORT);
 	if (error != OT_ERROR_NONE) {
 		LOG_ERR("Failed to start OT CoAP. Error: %d", error);
@@ -577,6 +1027,11 @@ void coap_client_toggle_mesh_lights(void)
 	submit_work_if_connected(&multicast_light_work);
 }
 
+void coap_client_sample_mesh(void)
+{
+	submit_work_if_connected(&sample_mesh_work);
+}
+
 void coap_client_send_provisioning_request(void)
 {
 	submit_work_if_connected(&provisioning_work);
@@ -588,3 +1043,24 @@ void coap_client_toggle_minimal_sleepy_end_device(void)
 		k_work_submit_to_queue(&coap_client_workq, &toggle_MTD_SED_work);
 	}
 }
+
+#if defined(CONFIG_SHELL)
+static int cmd_snapshot(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (!is_connected) {
+		shell_error(sh, "Not connected");
+		return -ENOTCONN;
+	}
+
+	coap_client_sample_mesh();
+	shell_print(sh, "Snapshot %u requested", (unsigned int)snapshot_seq + 1);
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(snapshot, NULL, "Sample every node of the mesh at once",
+		   cmd_snapshot);
+#endif
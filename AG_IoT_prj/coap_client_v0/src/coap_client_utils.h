@@ -56,6 +56,13 @@ void coap_client_toggle_one_light(void);
  */
 void coap_client_toggle_mesh_lights(void);
 
+/** @brief Sample every CoAP server in the network mesh at once.
+ *
+ * The servers answer with their reading on the snapshot resource, spread
+ * over a window sized to CONFIG_COAP_CLIENT_SYNC_NODES.
+ */
+void coap_client_sample_mesh(void);
+
 /** @brief Request for the CoAP server address to pair.
  *
  * @note Enable paring on the CoAP server to get the address.
@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/openthread.h>
+#include <zephyr/shell/shell.h>
+#include <openthread/coap.h>
+#include <openthread/ip6.h>
+#include <openthread/message.h>
+#include <coap_server_client_interface.h>
+
+#include "sensor_registry.h"
+
+LOG_MODULE_REGISTER(sensor_registry, LOG_LEVEL_INF);
+
+/* Twice the nodes keeps the probe sequences of the index short */
+#define REGISTRY_INDEX_SIZE (2 * CONFIG_COAP_CLIENT_REGISTRY_NODES)
+#define REGISTRY_WINDOW_DEFAULT_S 3600
+#define REGISTRY_TEXT_MAX 1024
+#define REGISTRY_QUERY_MAX 16
+
+struct registry_sample {
+	/* Collector uptime of the reading in seconds, negative if the
+	 * reading is older than the collector.
+	 */
+	int32_t time;
+	uint16_t values[CONFIG_COAP_CLIENT_REGISTRY_VALUES];
+};
+
+struct registry_node {
+	otIp6Address addr;
+	int32_t last_seen;
+	uint8_t unit_id;
+	uint8_t num_values;
+	/* Next sample to overwrite */
+	uint8_t head;
+	uint8_t num_samples;
+	struct registry_sample samples[CONFIG_COAP_CLIENT_REGISTRY_SAMPLES];
+};
+
+static K_MUTEX_DEFINE(registry_lock);
+
+static struct registry_node nodes[CONFIG_COAP_CLIENT_REGISTRY_NODES];
+static size_t num_nodes;
+/* Open addressing index of the nodes, holds the node index + 1, 0 if the
+ * slot is empty. Nodes are never removed, so no slot is ever freed.
+ */
+static uint8_t node_index[REGISTRY_INDEX_SIZE];
+
+/* Served from the OpenThread thread only */
+static char response_text[REGISTRY_TEXT_MAX];
+
+static otCoapResource registry_resource = {
+	.mUriPath = REGISTRY_URI_PATH,
+	.mHandler = NULL,
+	.mContext = NULL,
+	.mNext = NULL,
+};
+
+static int32_t now_s(void)
+{
+	return k_uptime_get() / MSEC_PER_SEC;
+}
+
+/* FNV-1a, the interface identifier of an EID is random already */
+static uint32_t key_hash(const otIp6Address *addr, uint8_t unit_id)
+{
+	uint32_t hash = 2166136261U;
+
+	for (size_t i = 0; i < sizeof(addr->mFields.m8); i++) {
+		hash = (hash ^ addr->mFields.m8[i]) * 16777619U;
+	}
+
+	return (hash ^ unit_id) * 16777619U;
+}
+
+/* Index slot of the key, or the empty slot where it would be inserted */
+static size_t index_slot(const otIp6Address *addr, uint8_t unit_id)
+{
+	size_t slot = key_hash(addr, unit_id) % REGISTRY_INDEX_SIZE;
+	struct registry_node *node;
+
+	while (node_index[slot] != 0) {
+		node = &nodes[node_index[slot] - 1];
+		if (node->unit_id == unit_id &&
+		    otIp6IsAddressEqual(&node->addr, addr)) {
+			break;
+		}
+
+		slot = (slot + 1) % REGISTRY_INDEX_SIZE;
+	}
+
+	return slot;
+}
+
+int sensor_registry_put(const otIp6Address *addr, uint8_t unit_id,
+			uint32_t age_ms, const uint16_t *values,
+			size_t num_values)
+{
+	struct registry_sample *sample;
+	struct registry_node *node;
+	size_t slot;
+	int32_t now;
+	int ret;
+
+	k_mutex_lock(&registry_lock, K_FOREVER);
+
+	slot = index_slot(addr, unit_id);
+	if (node_index[slot] == 0) {
+		if (num_nodes == ARRAY_SIZE(nodes)) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		node = &nodes[num_nodes];
+		memset(node, 0, sizeof(*node));
+		node->addr = *addr;
+		node->unit_id = unit_id;
+		node_index[slot] = ++num_nodes;
+
+		LOG_INF("Sensor %u: unit %u of a new node", num_nodes - 1,
+			unit_id);
+	}
+
+	ret = node_index[slot] - 1;
+	node = &nodes[ret];
+	now = now_s();
+
+	sample = &node->samples[node->head];
+	sample->time = now - (int32_t)MIN(age_ms / MSEC_PER_SEC, INT32_MAX);
+	node->num_values = MIN(num_values, ARRAY_SIZE(sample->values));
+	memcpy(sample->values, values,
+	       node->num_values * sizeof(sample->values[0]));
+
+	node->head = (node->head + 1) % ARRAY_SIZE(node->samples);
+	node->num_samples = MIN(node->num_samples + 1,
+				ARRAY_SIZE(node->samples));
+	node->last_seen = now;
+
+out:
+	k_mutex_unlock(&registry_lock);
+
+	return ret;
+}
+
+int sensor_registry_find(const otIp6Address *addr, uint8_t unit_id)
+{
+	int ret;
+
+	k_mutex_lock(&registry_lock, K_FOREVER);
+	ret = node_index[index_slot(addr, unit_id)] - 1;
+	k_mutex_unlock(&registry_lock);
+
+	return ret < 0 ? -ENOENT : ret;
+}
+
+size_t sensor_registry_count(void)
+{
+	return num_nodes;
+}
+
+int sensor_registry_info_get(size_t idx, struct sensor_registry_info *info)
+{
+	struct registry_node *node;
+
+	if (idx >= num_nodes) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&registry_lock, K_FOREVER);
+	node = &nodes[idx];
+	info->addr = node->addr;
+	info->unit_id = node->unit_id;
+	info->num_values = node->num_values;
+	info->num_samples = node->num_samples;
+	info->silent_s = now_s() - node->last_seen;
+	k_mutex_unlock(&registry_lock);
+
+	return 0;
+}
+
+/* Readings of a batch may arrive after newer ones, look at the times */
+static const struct registry_sample *latest_sample(
+	const struct registry_node *node)
+{
+	const struct registry_sample *latest = NULL;
+
+	for (size_t i = 0; i < node->num_samples; i++) {
+		if (latest == NULL || node->samples[i].time > latest->time) {
+			latest = &node->samples[i];
+		}
+	}
+
+	return latest;
+}
+
+int sensor_registry_latest(size_t idx, uint32_t *age_s, uint16_t *values,
+			   size_t max_values)
+{
+	const struct registry_sample *sample;
+	int ret;
+
+	if (idx >= num_nodes) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&registry_lock, K_FOREVER);
+
+	sample = latest_sample(&nodes[idx]);
+	if (sample == NULL) {
+		ret = -ENODATA;
+		goto out;
+	}
+
+	ret = MIN(max_values, nodes[idx].num_values);
+	memcpy(values, sample->values, ret * sizeof(values[0]));
+	*age_s = now_s() - sample->time;
+
+out:
+	k_mutex_unlock(&registry_lock);
+
+	return ret;
+}
+
+int sensor_registry_stats_get(size_t idx, size_t channel, uint32_t window_s,
+			      struct sensor_registry_stats *stats)
+{
+	const struct registry_sample *sample;
+	const struct registry_node *node;
+	uint32_t sum = 0;
+	int32_t from;
+
+	if (idx >= num_nodes) {
+		return -ENOENT;
+	}
+
+	if (channel >= CONFIG_COAP_CLIENT_REGISTRY_VALUES) {
+		return -EINVAL;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	stats->min = UINT16_MAX;
+
+	k_mutex_lock(&registry_lock, K_FOREVER);
+
+	node = &nodes[idx];
+	from = now_s() - (int32_t)MIN(window_s, INT32_MAX);
+
+	for (size_t i = 0; i < node->num_samples; i++) {
+		sample = &node->samples[i];
+		if (sample->time < from) {
+			continue;
+		}
+
+		stats->min = MIN(stats->min, sample->values[channel]);
+		stats->max = MAX(stats->max, sample->values[channel]);
+		sum += sample->values[channel];
+		stats->count++;
+	}
+
+	k_mutex_unlock(&registry_lock);
+
+	if (stats->count == 0) {
+		stats->min = 0;
+	} else {
+		stats->avg = (sum + stats->count / 2) / stats->count;
+	}
+
+	return 0;
+}
+
+/* Append to a text, returns false once the text is full */
+static bool text_append(char *buf, size_t size, size_t *len,
+			const char *fmt, ...)
+{
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = vsnprintk(&buf[*len], size - *len, fmt, args);
+	va_end(args);
+
+	if (ret < 0 || ret >= size - *len) {
+		buf[*len] = '\0';
+		return false;
+	}
+
+	*len += ret;
+
+	return true;
+}
+
+static size_t registry_list_format(char *buf, size_t size)
+{
+	struct sensor_registry_info info;
+	char iid[2 * OT_IP6_IID_SIZE + 1];
+	size_t len = 0;
+
+	buf[0] = '\0';
+
+	for (size_t i = 0; i < sensor_registry_count(); i++) {
+		if (sensor_registry_info_get(i, &info)) {
+			break;
+		}
+
+		bin2hex(&info.addr.mFields.m8[OT_IP6_ADDRESS_SIZE -
+					      OT_IP6_IID_SIZE],
+			OT_IP6_IID_SIZE, iid, sizeof(iid));
+
+		if (!text_append(buf, size, &len,
+				 "%u %s unit %u samples %u silent %us\n", i, iid,
+				 info.unit_id, info.num_samples,
+				 info.silent_s)) {
+			break;
+		}
+	}
+
+	return len;
+}
+
+static size_t registry_sensor_format(char *buf, size_t size, size_t idx,
+				     uint32_t window_s)
+{
+	uint16_t values[CONFIG_COAP_CLIENT_REGISTRY_VALUES];
+	char addr[OT_IP6_ADDRESS_STRING_SIZE];
+	struct sensor_registry_stats stats;
+	struct sensor_registry_info info;
+	uint32_t age_s;
+	size_t len = 0;
+	int num;
+
+	buf[0] = '\0';
+
+	if (sensor_registry_info_get(idx, &info)) {
+		return 0;
+	}
+
+	otIp6AddressToString(&info.addr, addr, sizeof(addr));
+
+	num = sensor_registry_latest(idx, &age_s, values, ARRAY_SIZE(values));
+	if (num < 0) {
+		text_append(buf, size, &len, "%s unit %u no data\n", addr,
+			    info.unit_id);
+		return len;
+	}
+
+	if (!text_append(buf, size, &len, "%s unit %u age %us window %us\n",
+			 addr, info.unit_id, age_s, window_s)) {
+		return len;
+	}
+
+	for (int i = 0; i < num; i++) {
+		sensor_registry_stats_get(idx, i, window_s, &stats);
+		if (!text_append(buf, size, &len,
+				 "ch%d %u min %u max %u avg %u n %u\n", i,
+				 values[i], stats.min, stats.max, stats.avg,
+				 stats.count)) {
+			break;
+		}
+	}
+
+	return len;
+}
+
+static void registry_query_parse(otMessage *message, long *idx,
+				 uint32_t *window_s)
+{
+	char query[REGISTRY_QUERY_MAX];
+	const otCoapOption *option;
+	otCoapOptionIterator iterator;
+
+	if (otCoapOptionIteratorInit(&iterator, message) != OT_ERROR_NONE) {
+		return;
+	}
+
+	for (option = otCoapOptionIteratorGetFirstOptionMatching(
+		     &iterator, OT_COAP_OPTION_URI_QUERY);
+	     option != NULL;
+	     option = otCoapOptionIteratorGetNextOptionMatching(
+		     &iterator, OT_COAP_OPTION_URI_QUERY)) {
+		if (option->mLength >= sizeof(query) ||
+		    otCoapOptionIteratorGetOptionValue(&iterator, query) !=
+			    OT_ERROR_NONE) {
+			continue;
+		}
+
+		query[option->mLength] = '\0';
+
+		if (strncmp(query, "n=", 2) == 0) {
+			*idx = strtol(&query[2], NULL, 0);
+		} else if (strncmp(query, "w=", 2) == 0) {
+			*window_s = strtoul(&query[2], NULL, 0);
+		}
+	}
+}
+
+static void registry_request_handler(void *context, otMessage *message,
+				     const otMessageInfo *message_info)
+{
+	uint32_t window_s = REGISTRY_WINDOW_DEFAULT_S;
+	otError error = OT_ERROR_NO_BUFS;
+	otMessage *response;
+	otCoapType type;
+	size_t len;
+	long idx = -1;
+
+	if (otCoapMessageGetCode(message) != OT_COAP_CODE_GET) {
+		LOG_ERR("Registry handler - Unexpected CoAP code");
+		return;
+	}
+
+	registry_query_parse(message, &idx, &window_s);
+
+	if (idx < 0) {
+		len = registry_list_format(response_text,
+					   sizeof(response_text));
+	} else {
+		len = registry_sensor_format(response_text,
+					     sizeof(response_text), idx,
+					     window_s);
+	}
+
+	response = otCoapNewMessage(context, NULL);
+	if (response == NULL) {
+		goto end;
+	}
+
+	type = otCoapMessageGetType(message) == OT_COAP_TYPE_CONFIRMABLE ?
+	       OT_COAP_TYPE_ACKNOWLEDGMENT : OT_COAP_TYPE_NON_CONFIRMABLE;
+
+	error = otCoapMessageInitResponse(response, message, type,
+					  len > 0 || idx < 0 ?
+					  OT_COAP_CODE_CONTENT :
+					  OT_COAP_CODE_NOT_FOUND);
+	if (error != OT_ERROR_NONE || len == 0) {
+		goto send;
+	}
+
+	error = otCoapMessageAppendContentFormatOption(
+		response, OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapMessageSetPayloadMarker(response);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otMessageAppend(response, response_text, len);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+send:
+	if (error == OT_ERROR_NONE) {
+		error = otCoapSendResponse(context, response, message_info);
+	}
+
+end:
+	if (error != OT_ERROR_NONE && response != NULL) {
+		LOG_ERR("Failed to send registry response: %d", error);
+		otMessageFree(response);
+	}
+}
+
+int sensor_registry_init(void)
+{
+	otInstance *ot = openthread_get_default_instance();
+
+	if (ot == NULL) {
+		return -ENODEV;
+	}
+
+	registry_resource.mContext = ot;
+	registry_resource.mHandler = registry_request_handler;
+	otCoapAddResource(ot, &registry_resource);
+
+	return 0;
+}
+
+#if defined(CONFIG_SHELL)
+static char shell_text[REGISTRY_TEXT_MAX];
+
+static int cmd_list(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	registry_list_format(shell_text, sizeof(shell_text));
+	shell_fprintf(sh, SHELL_NORMAL, "%s", shell_text);
+
+	return 0;
+}
+
+static int cmd_show(const struct shell *sh, size_t argc, char **argv)
+{
+	uint32_t window_s = REGISTRY_WINDOW_DEFAULT_S;
+	unsigned long idx = strtoul(argv[1], NULL, 0);
+
+	if (argc > 2) {
+		window_s = strtoul(argv[2], NULL, 0);
+	}
+
+	if (registry_sensor_format(shell_text, sizeof(shell_text), idx,
+				   window_s) == 0) {
+		shell_error(sh, "No sensor %lu", idx);
+		return -ENOENT;
+	}
+
+	shell_fprintf(sh, SHELL_NORMAL, "%s", shell_text);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(registry_cmds,
+	SHELL_CMD(list, NULL, "List the known sensors", cmd_list),
+	SHELL_CMD_ARG(show, NULL,
+		      "Show one sensor <index> [window s]", cmd_show, 2, 1),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(registry, &registry_cmds, "Sensors known to the collector",
+		   NULL);
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __SENSOR_REGISTRY_H__
+#define __SENSOR_REGISTRY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <openthread/ip6.h>
+
+/** Description of one sensor known to the collector */
+struct sensor_registry_info {
+	/** Mesh-local EID of the node */
+	otIp6Address addr;
+	/** Modbus unit ID of the sensor on the node */
+	uint8_t unit_id;
+	/** Number of values of the last reading */
+	uint8_t num_values;
+	/** Number of readings kept */
+	uint8_t num_samples;
+	/** Seconds since the last reading was received */
+	uint32_t silent_s;
+};
+
+/** Aggregate of one channel over a time window */
+struct sensor_registry_stats {
+	/** Number of readings in the window */
+	uint16_t count;
+	uint16_t min;
+	uint16_t max;
+	/** Average, rounded to the nearest register unit */
+	uint16_t avg;
+};
+
+/** @brief Add the registry resource to the OpenThread CoAP server.
+ *
+ * A GET on REGISTRY_URI_PATH lists the known sensors as text, one per
+ * line. With the query "n=<index>" it returns the latest reading of one
+ * sensor and the minimum, maximum and average of every channel over the
+ * last hour, or over "w=<seconds>".
+ *
+ * @retval 0 on success, negative error code otherwise.
+ */
+int sensor_registry_init(void);
+
+/** @brief Record a reading.
+ *
+ * A sensor is identified by the address of its node and its unit ID.
+ * Unknown sensors are added while there is room. The reading received
+ * first is dropped when the ring of the sensor is full.
+ *
+ * @param[in] addr       Mesh-local EID of the node.
+ * @param[in] unit_id    Modbus unit ID of the sensor.
+ * @param[in] age_ms     Age of the reading.
+ * @param[in] values     Register values.
+ * @param[in] num_values Number of values, the values beyond
+ *                       CONFIG_COAP_CLIENT_REGISTRY_VALUES are not kept.
+ *
+ * @retval Index of the sensor, -ENOMEM if the registry is full.
+ */
+int sensor_registry_put(const otIp6Address *addr, uint8_t unit_id,
+			uint32_t age_ms, const uint16_t *values,
+			size_t num_values);
+
+/** @brief Look a sensor up.
+ *
+ * @retval Index of the sensor, -ENOENT if it is not known.
+ */
+int sensor_registry_find(const otIp6Address *addr, uint8_t unit_id);
+
+/** @brief Get the number of known sensors.
+ *
+ * Sensors are indexed from 0 in the order they were first heard of.
+ */
+size_t sensor_registry_count(void);
+
+/** @brief Describe a sensor.
+ *
+ * @retval 0 on success, -ENOENT if the index is not used.
+ */
+int sensor_registry_info_get(size_t idx, struct sensor_registry_info *info);
+
+/** @brief Get the latest reading of a sensor.
+ *
+ * @param[in]  idx        Index of the sensor.
+ * @param[out] age_s      Age of the reading in seconds.
+ * @param[out] values     Register values.
+ * @param[in]  max_values Size of @p values.
+ *
+ * @retval Number of values copied, -ENOENT if the index is not used,
+ *         -ENODATA if the sensor has no reading.
+ */
+int sensor_registry_latest(size_t idx, uint32_t *age_s, uint16_t *values,
+			   size_t max_values);
+
+/** @brief Aggregate one channel of a sensor over a time window.
+ *
+ * @param[in]  idx      Index of the sensor.
+ * @param[in]  channel  Value index.
+ * @param[in]  window_s Length of the window ending now, in seconds.
+ * @param[out] stats    Aggregate, count is 0 if no reading is in the
+ *                      window.
+ *
+ * @retval 0 on success, -ENOENT if the index is not used, -EINVAL if the
+ *         channel is not kept.
+ */
+int sensor_registry_stats_get(size_t idx, size_t channel, uint32_t window_s,
+			      struct sensor_registry_stats *stats);
+
+#endif
@@ -7,6 +7,11 @@
 #ifndef __COAP_SERVER_CLIENT_INTRFACE_H__
 #define __COAP_SERVER_CLIENT_INTRFACE_H__
 
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/byteorder.h>
+
 #define COAP_PORT 5683
 
 /**@brief Enumeration describing light commands. */
@@ -18,5 +23,332 @@ enum light_command {
 
 #define PROVISIONING_URI_PATH "provisioning"
 #define LIGHT_URI_PATH "light"
+#define SENSOR_URI_PATH "sensor"
+#define SAMPLE_URI_PATH "sample"
+#define SNAPSHOT_URI_PATH "snapshot"
+#define REGISTRY_URI_PATH "registry"
+
+/*
+ * Sensor telemetry payload:
+ *
+ *   byte 0     SENSOR_PAYLOAD_VERSION
+ *   byte 1     Modbus unit ID of the sensor
+ *   byte 2     number of values N
+ *   byte 3..   N register values, big endian
+ */
+#define SENSOR_PAYLOAD_VERSION 1
+#define SENSOR_PAYLOAD_HDR_LEN 3
+#define SENSOR_PAYLOAD_MAX_VALUES 16
+#define SENSOR_PAYLOAD_LEN(num) (SENSOR_PAYLOAD_HDR_LEN + 2 * (num))
+#define SENSOR_PAYLOAD_MAX_LEN SENSOR_PAYLOAD_LEN(SENSOR_PAYLOAD_MAX_VALUES)
+
+/**@brief Encode sensor values into a telemetry payload.
+ *
+ * @param[out] buf        Payload buffer.
+ * @param[in]  size       Size of @p buf.
+ * @param[in]  unit_id    Modbus unit ID of the sensor.
+ * @param[in]  values     Register values.
+ * @param[in]  num_values Number of values.
+ *
+ * @retval Length of the payload, -ENOBUFS if it does not fit into @p buf.
+ */
+static inline int sensor_payload_encode(uint8_t *buf, size_t size,
+					uint8_t unit_id, const uint16_t *values,
+					size_t num_values)
+{
+	if (num_values > SENSOR_PAYLOAD_MAX_VALUES ||
+	    size < SENSOR_PAYLOAD_LEN(num_values)) {
+		return -ENOBUFS;
+	}
+
+	buf[0] = SENSOR_PAYLOAD_VERSION;
+	buf[1] = unit_id;
+	buf[2] = (uint8_t)num_values;
+
+	for (size_t i = 0; i < num_values; i++) {
+		sys_put_be16(values[i], &buf[SENSOR_PAYLOAD_LEN(i)]);
+	}
+
+	return SENSOR_PAYLOAD_LEN(num_values);
+}
+
+/**@brief Decode a telemetry payload.
+ *
+ * @param[in]  buf        Payload.
+ * @param[in]  len        Length of the payload.
+ * @param[out] unit_id    Modbus unit ID of the sensor.
+ * @param[out] values     Register values.
+ * @param[in]  max_values Size of @p values.
+ *
+ * @retval Number of values decoded, -EINVAL if the payload is malformed,
+ *         -ENOTSUP for an unknown version, -ENOBUFS if @p values is
+ *         too small.
+ */
+static inline int sensor_payload_decode(const uint8_t *buf, size_t len,
+					uint8_t *unit_id, uint16_t *values,
+					size_t max_values)
+{
+	size_t num_values;
+
+	if (len < SENSOR_PAYLOAD_HDR_LEN) {
+		return -EINVAL;
+	}
+
+	if (buf[0] != SENSOR_PAYLOAD_VERSION) {
+		return -ENOTSUP;
+	}
+
+	num_values = buf[2];
+	if (len != SENSOR_PAYLOAD_LEN(num_values)) {
+		return -EINVAL;
+	}
+
+	if (num_values > max_values) {
+		return -ENOBUFS;
+	}
+
+	*unit_id = buf[1];
+	for (size_t i = 0; i < num_values; i++) {
+		values[i] = sys_get_be16(&buf[SENSOR_PAYLOAD_LEN(i)]);
+	}
+
+	return num_values;
+}
+
+
+/*
+ * Sensor batch payload, several readings in one message:
+ *
+ *   byte 0     SENSOR_BATCH_VERSION
+ *   byte 1     number of records
+ *   records    age of the reading in ms when sent (4 bytes, big endian,
+ *              SENSOR_BATCH_AGE_UNKNOWN if lost across a reset), followed
+ *              by the reading in the sensor telemetry payload format
+ */
+#define SENSOR_BATCH_VERSION 2
+#define SENSOR_BATCH_HDR_LEN 2
+#define SENSOR_BATCH_REC_HDR_LEN 4
+#define SENSOR_BATCH_AGE_UNKNOWN UINT32_MAX
+/* Keeps a batch within a single 802.15.4 frame */
+#define SENSOR_BATCH_MAX_LEN 72
+/* Largest batch sent block-wise, the receiver keeps it whole */
+#define SENSOR_BATCH_TRANSFER_MAX_LEN 1280
+
+/**@brief Start an empty batch.
+ *
+ * @retval Length of the batch, -ENOBUFS if @p size is too small.
+ */
+static inline int sensor_batch_init(uint8_t *buf, size_t size)
+{
+	if (size < SENSOR_BATCH_HDR_LEN) {
+		return -ENOBUFS;
+	}
+
+	buf[0] = SENSOR_BATCH_VERSION;
+	buf[1] = 0;
+
+	return SENSOR_BATCH_HDR_LEN;
+}
+
+/**@brief Append a reading to a batch.
+ *
+ * @param[in,out] buf        Batch started with sensor_batch_init().
+ * @param[in]     size       Size of @p buf.
+ * @param[in]     len        Current length of the batch.
+ * @param[in]     age_ms     Age of the reading.
+ * @param[in]     unit_id    Modbus unit ID of the sensor.
+ * @param[in]     values     Register values.
+ * @param[in]     num_values Number of values.
+ *
+ * @retval New length of the batch, -ENOBUFS if the reading does not fit.
+ */
+static inline int sensor_batch_append(uint8_t *buf, size_t size, size_t len,
+				      uint32_t age_ms, uint8_t unit_id,
+				      const uint16_t *values, size_t num_values)
+{
+	int ret;
+
+	if (buf[1] == UINT8_MAX || size < len + SENSOR_BATCH_REC_HDR_LEN) {
+		return -ENOBUFS;
+	}
+
+	ret = sensor_payload_encode(&buf[len + SENSOR_BATCH_REC_HDR_LEN],
+				    size - len - SENSOR_BATCH_REC_HDR_LEN,
+				    unit_id, values, num_values);
+	if (ret < 0) {
+		return ret;
+	}
+
+	sys_put_be32(age_ms, &buf[len]);
+	buf[1]++;
+
+	return len + SENSOR_BATCH_REC_HDR_LEN + ret;
+}
+
+/**@brief Decode the next reading of a batch.
+ *
+ * @param[in]     buf        Batch payload.
+ * @param[in]     len        Length of the batch.
+ * @param[in,out] offset     Offset of the record, SENSOR_BATCH_HDR_LEN for
+ *                           the first one, advanced to the next record.
+ * @param[out]    age_ms     Age of the reading.
+ * @param[out]    unit_id    Modbus unit ID of the sensor.
+ * @param[out]    values     Register values.
+ * @param[in]     max_values Size of @p values.
+ *
+ * @retval Number of values decoded, -ENOENT after the last record,
+ *         other negative error code if the batch is malformed.
+ */
+static inline int sensor_batch_next(const uint8_t *buf, size_t len,
+				    size_t *offset, uint32_t *age_ms,
+				    uint8_t *unit_id, uint16_t *values,
+				    size_t max_values)
+{
+	const uint8_t *rec;
+	size_t rec_len;
+	int ret;
+
+	if (len < SENSOR_BATCH_HDR_LEN || buf[0] != SENSOR_BATCH_VERSION) {
+		return -EINVAL;
+	}
+
+	if (*offset == len) {
+		return -ENOENT;
+	}
+
+	if (len - *offset < SENSOR_BATCH_REC_HDR_LEN + SENSOR_PAYLOAD_HDR_LEN) {
+		return -EINVAL;
+	}
+
+	rec = &buf[*offset + SENSOR_BATCH_REC_HDR_LEN];
+	rec_len = SENSOR_PAYLOAD_LEN(rec[2]);
+	if (len - *offset - SENSOR_BATCH_REC_HDR_LEN < rec_len) {
+		return -EINVAL;
+	}
+
+	ret = sensor_payload_decode(rec, rec_len, unit_id, values, max_values);
+	if (ret < 0) {
+		return ret;
+	}
+
+	*age_ms = sys_get_be32(&buf[*offset]);
+	*offset += SENSOR_BATCH_REC_HDR_LEN + rec_len;
+
+	return ret;
+}
+
+/*
+ * Synchronized sampling trigger, multicast by the collector:
+ *
+ *   byte 0     SAMPLE_TRIGGER_VERSION
+ *   byte 1..2  sequence number of the snapshot, big endian
+ *   byte 3..4  number of nodes expected to answer, big endian
+ *
+ * Every node samples at once and answers with a snapshot payload, spread
+ * over a window sized to the number of nodes.
+ */
+#define SAMPLE_TRIGGER_VERSION 1
+#define SAMPLE_TRIGGER_LEN 5
+
+/**@brief Encode a synchronized sampling trigger.
+ *
+ * @retval Length of the payload, -ENOBUFS if it does not fit into @p buf.
+ */
+static inline int sample_trigger_encode(uint8_t *buf, size_t size,
+					uint16_t seq, uint16_t num_nodes)
+{
+	if (size < SAMPLE_TRIGGER_LEN) {
+		return -ENOBUFS;
+	}
+
+	buf[0] = SAMPLE_TRIGGER_VERSION;
+	sys_put_be16(seq, &buf[1]);
+	sys_put_be16(num_nodes, &buf[3]);
+
+	return SAMPLE_TRIGGER_LEN;
+}
+
+/**@brief Decode a synchronized sampling trigger.
+ *
+ * @retval 0 on success, -EINVAL if the payload is malformed, -ENOTSUP if
+ *         its version is not supported.
+ */
+static inline int sample_trigger_decode(const uint8_t *buf, size_t len,
+					uint16_t *seq, uint16_t *num_nodes)
+{
+	if (len < 1) {
+		return -EINVAL;
+	}
+
+	if (buf[0] != SAMPLE_TRIGGER_VERSION) {
+		return -ENOTSUP;
+	}
+
+	if (len != SAMPLE_TRIGGER_LEN) {
+		return -EINVAL;
+	}
+
+	*seq = sys_get_be16(&buf[1]);
+	*num_nodes = sys_get_be16(&buf[3]);
+
+	return 0;
+}
+
+/*
+ * Snapshot payload, the answer of a node to a sampling trigger:
+ *
+ *   byte 0..1  sequence number of the trigger, big endian
+ *   byte 2..   the reading in the sensor telemetry payload format
+ */
+#define SENSOR_SNAPSHOT_HDR_LEN 2
+#define SENSOR_SNAPSHOT_MAX_LEN (SENSOR_SNAPSHOT_HDR_LEN +		\
+				 SENSOR_PAYLOAD_MAX_LEN)
+
+/**@brief Encode the answer to a sampling trigger.
+ *
+ * @retval Length of the payload, -ENOBUFS if it does not fit into @p buf.
+ */
+static inline int sensor_snapshot_encode(uint8_t *buf, size_t size,
+					 uint16_t seq, uint8_t unit_id,
+					 const uint16_t *values,
+					 size_t num_values)
+{
+	int ret;
+
+	if (size < SENSOR_SNAPSHOT_HDR_LEN) {
+		return -ENOBUFS;
+	}
+
+	ret = sensor_payload_encode(&buf[SENSOR_SNAPSHOT_HDR_LEN],
+				    size - SENSOR_SNAPSHOT_HDR_LEN, unit_id,
+				    values, num_values);
+	if (ret < 0) {
+		return ret;
+	}
+
+	sys_put_be16(seq, buf);
+
+	return SENSOR_SNAPSHOT_HDR_LEN + ret;
+}
+
+/**@brief Decode the answer to a sampling trigger.
+ *
+ * @retval Number of values decoded, negative error code if the payload
+ *         is malformed.
+ */
+static inline int sensor_snapshot_decode(const uint8_t *buf, size_t len,
+					 uint16_t *seq, uint8_t *unit_id,
+					 uint16_t *values, size_t max_values)
+{
+	if (len < SENSOR_SNAPSHOT_HDR_LEN) {
+		return -EINVAL;
+	}
+
+	*seq = sys_get_be16(buf);
+
+	return sensor_payload_decode(&buf[SENSOR_SNAPSHOT_HDR_LEN],
+				     len - SENSOR_SNAPSHOT_HDR_LEN, unit_id,
+				     values, max_values);
+}
 
 #endif
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/openthread.h>
+#include <openthread/coap.h>
+#include <openthread/message.h>
+#include <coap_server_client_interface.h>
+
+#include "coap_block.h"
+#include "coap_con.h"
+
+LOG_MODULE_REGISTER(coap_block, LOG_LEVEL_INF);
+
+#define BLOCK_TOKEN_LEN 4
+#define BLOCK_SZX_MAX 6
+/* Largest acknowledgment payload handed to the completion callback */
+#define BLOCK_ACK_PAYLOAD_MAX 8
+
+/* Accessed with the OpenThread API mutex held only */
+static struct block_transfer {
+	otMessageInfo info;
+	const char *uri_path;
+	const uint8_t *payload;
+	size_t len;
+	uint32_t num;
+	uint8_t szx;
+	uint8_t token[BLOCK_TOKEN_LEN];
+	coap_block_done_cb_t done;
+	bool active;
+} transfer;
+
+static void block_response_handler(void *context, otMessage *message,
+				   const otMessageInfo *message_info,
+				   otError result);
+
+static size_t block_size(void)
+{
+	return 16U << transfer.szx;
+}
+
+static bool block_more(void)
+{
+	return (transfer.num + 1) * block_size() < transfer.len;
+}
+
+static otError block_send(otInstance *ot)
+{
+	size_t offset = transfer.num * block_size();
+	otError error = OT_ERROR_NO_BUFS;
+	otMessage *message;
+
+	message = otCoapNewMessage(ot, NULL);
+	if (message == NULL) {
+		goto end;
+	}
+
+	otCoapMessageInit(message, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_PUT);
+
+	/* One token for the whole transfer lets the peer tell it apart from
+	 * transfers of other nodes
+	 */
+	if (transfer.num == 0) {
+		otCoapMessageGenerateToken(message, BLOCK_TOKEN_LEN);
+		memcpy(transfer.token, otCoapMessageGetToken(message),
+		       sizeof(transfer.token));
+	} else {
+		error = otCoapMessageSetToken(message, transfer.token,
+					      sizeof(transfer.token));
+		if (error != OT_ERROR_NONE) {
+			goto end;
+		}
+	}
+
+	error = otCoapMessageAppendUriPathOptions(message, transfer.uri_path);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapMessageAppendContentFormatOption(
+		message, OT_COAP_OPTION_CONTENT_FORMAT_OCTET_STREAM);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapMessageAppendBlock1Option(message, transfer.num,
+						block_more(), transfer.szx);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	if (transfer.num == 0) {
+		/* Lets the peer reject a transfer it cannot hold at once */
+		error = otCoapMessageAppendUintOption(
+			message, OT_COAP_OPTION_SIZE1, transfer.len);
+		if (error != OT_ERROR_NONE) {
+			goto end;
+		}
+	}
+
+	error = otCoapMessageSetPayloadMarker(message);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otMessageAppend(message, &transfer.payload[offset],
+				MIN(block_size(), transfer.len - offset));
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapSendRequestWithParameters(ot, message, &transfer.info,
+						block_response_handler, ot,
+						coap_con_tx_parameters());
+
+end:
+	if (error != OT_ERROR_NONE && message != NULL) {
+		otMessageFree(message);
+	}
+
+	return error;
+}
+
+static void block_transfer_end(int err, const uint8_t *payload, uint16_t len)
+{
+	transfer.active = false;
+
+	if (err) {
+		LOG_WRN("Block-wise transfer failed at block %u (%d)",
+			transfer.num, err);
+	} else {
+		LOG_INF("Block-wise transfer of %u bytes done", transfer.len);
+	}
+
+	transfer.done(err, payload, len);
+}
+
+static void block_response_handler(void *context, otMessage *message,
+				   const otMessageInfo *message_info,
+				   otError result)
+{
+	uint8_t payload[BLOCK_ACK_PAYLOAD_MAX];
+	uint16_t len;
+	otCoapCode code;
+
+	ARG_UNUSED(message_info);
+
+	if (result != OT_ERROR_NONE) {
+		block_transfer_end(-ETIMEDOUT, NULL, 0);
+		return;
+	}
+
+	code = otCoapMessageGetCode(message);
+
+	if (!block_more()) {
+		if (code != OT_COAP_CODE_CHANGED &&
+		    code != OT_COAP_CODE_CREATED) {
+			block_transfer_end(-EIO, NULL, 0);
+			return;
+		}
+
+		len = otMessageRead(message, otMessageGetOffset(message),
+				    payload, sizeof(payload));
+		block_transfer_end(0, payload, len);
+		return;
+	}
+
+	if (code != OT_COAP_CODE_CONTINUE) {
+		block_transfer_end(-EIO, NULL, 0);
+		return;
+	}
+
+	transfer.num++;
+	if (block_send(context) != OT_ERROR_NONE) {
+		block_transfer_end(-ENOMEM, NULL, 0);
+	}
+}
+
+int coap_block_put(const struct sockaddr_in6 *peer, const char *uri_path,
+		   const uint8_t *payload, size_t len, uint8_t szx,
+		   coap_block_done_cb_t done)
+{
+	struct openthread_context *context = openthread_get_default_context();
+	int ret = 0;
+
+	if (szx > BLOCK_SZX_MAX || len == 0) {
+		return -EINVAL;
+	}
+
+	openthread_api_mutex_lock(context);
+
+	if (transfer.active) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	memset(&transfer.info, 0, sizeof(transfer.info));
+	memcpy(&transfer.info.mPeerAddr, &peer->sin6_addr,
+	       sizeof(transfer.info.mPeerAddr));
+	transfer.info.mPeerPort = COAP_PORT;
+
+	transfer.uri_path = uri_path;
+	transfer.payload = payload;
+	transfer.len = len;
+	transfer.num = 0;
+	transfer.szx = szx;
+	transfer.done = done;
+
+	if (block_send(context->instance) != OT_ERROR_NONE) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	transfer.active = true;
+
+out:
+	openthread_api_mutex_unlock(context);
+
+	return ret;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __COAP_BLOCK_H__
+#define __COAP_BLOCK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net/socket.h>
+
+/** @brief Type of the function called when a block-wise transfer ends.
+ *
+ * Called from the OpenThread thread.
+ *
+ * @param[in] err     0 if the peer acknowledged every block, negative error
+ *                    code otherwise.
+ * @param[in] payload Payload piggybacked on the acknowledgment of the last
+ *                    block.
+ * @param[in] len     Length of @p payload.
+ */
+typedef void (*coap_block_done_cb_t)(int err, const uint8_t *payload,
+				     uint16_t len);
+
+/** @brief Send a payload larger than one frame with a block-wise PUT.
+ *
+ * The payload is sent in confirmable requests carrying the Block1 option
+ * (RFC 7959), one block at a time, the next block going out once the
+ * peer answered 2.31 Continue to the previous one.
+ *
+ * @param[in] peer     Address of the peer.
+ * @param[in] uri_path URI path of the resource.
+ * @param[in] payload  Payload, valid until @p done is called.
+ * @param[in] len      Length of the payload.
+ * @param[in] szx      Block size exponent, blocks are 16 << szx bytes.
+ * @param[in] done     Completion callback.
+ *
+ * @retval 0 if the first block was sent, -EBUSY if a transfer is ongoing,
+ *         other negative error code otherwise.
+ */
+int coap_block_put(const struct sockaddr_in6 *peer, const char *uri_path,
+		   const uint8_t *payload, size_t len, uint8_t szx,
+		   coap_block_done_cb_t done);
+
+#endif
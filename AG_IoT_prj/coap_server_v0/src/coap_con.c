@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/openthread.h>
+#include <openthread/coap.h>
+#include <openthread/message.h>
+#include <coap_server_client_interface.h>
+
+#include "coap_con.h"
+
+LOG_MODULE_REGISTER(coap_con, LOG_LEVEL_INF);
+
+#define CON_TOKEN_LEN 4
+/* Largest acknowledgment payload handed to the completion callback */
+#define CON_ACK_PAYLOAD_MAX 8
+
+/* Retransmissions are bounded so a sleepy node does not stay awake */
+static const otCoapTxParameters tx_parameters = {
+	.mAckTimeout = CONFIG_COAP_SERVER_CON_ACK_TIMEOUT_MS,
+	.mAckRandomFactorNumerator = 3,
+	.mAckRandomFactorDenominator = 2,
+	.mMaxRetransmit = CONFIG_COAP_SERVER_CON_MAX_RETRANSMIT,
+};
+
+const otCoapTxParameters *coap_con_tx_parameters(void)
+{
+	return &tx_parameters;
+}
+
+static void con_response_handler(void *context, otMessage *message,
+				 const otMessageInfo *message_info,
+				 otError result)
+{
+	coap_con_done_cb_t done = (coap_con_done_cb_t)context;
+	uint8_t payload[CON_ACK_PAYLOAD_MAX];
+	uint16_t len = 0;
+	otCoapCode code;
+	int err = 0;
+
+	ARG_UNUSED(message_info);
+
+	if (result != OT_ERROR_NONE) {
+		LOG_WRN("Confirmable request not acknowledged (%d)", result);
+		err = -ETIMEDOUT;
+		goto end;
+	}
+
+	code = otCoapMessageGetCode(message);
+	if (code != OT_COAP_CODE_CHANGED && code != OT_COAP_CODE_CREATED) {
+		LOG_WRN("Confirmable request rejected with %u.%02u", code >> 5,
+			code & 0x1f);
+		err = -EIO;
+		goto end;
+	}
+
+	len = otMessageRead(message, otMessageGetOffset(message), payload,
+			    sizeof(payload));
+
+end:
+	if (done != NULL) {
+		done(err, payload, len);
+	}
+}
+
+int coap_con_put(const struct sockaddr_in6 *peer, const char *uri_path,
+		 const uint8_t *payload, size_t len, coap_con_done_cb_t done)
+{
+	struct openthread_context *context = openthread_get_default_context();
+	otError error = OT_ERROR_NO_BUFS;
+	otMessageInfo info;
+	otMessage *message;
+
+	memset(&info, 0, sizeof(info));
+	memcpy(&info.mPeerAddr, &peer->sin6_addr, sizeof(info.mPeerAddr));
+	info.mPeerPort = COAP_PORT;
+
+	openthread_api_mutex_lock(context);
+
+	message = otCoapNewMessage(context->instance, NULL);
+	if (message == NULL) {
+		goto end;
+	}
+
+	otCoapMessageInit(message, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_PUT);
+	otCoapMessageGenerateToken(message, CON_TOKEN_LEN);
+
+	error = otCoapMessageAppendUriPathOptions(message, uri_path);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapMessageSetPayloadMarker(message);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otMessageAppend(message, payload, len);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapSendRequestWithParameters(context->instance, message,
+						&info, con_response_handler,
+						done, &tx_parameters);
+
+end:
+	if (error != OT_ERROR_NONE && message != NULL) {
+		otMessageFree(message);
+	}
+
+	openthread_api_mutex_unlock(context);
+
+	return error == OT_ERROR_NONE ? 0 : -ENOMEM;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __COAP_CON_H__
+#define __COAP_CON_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net/socket.h>
+#include <openthread/coap.h>
+
+/** @brief Type of the function called when a confirmable request ends.
+ *
+ * Called from the OpenThread thread.
+ *
+ * @param[in] err     0 if the peer acknowledged the request, -ETIMEDOUT
+ *                    if every retransmission was lost, -EIO if the peer
+ *                    rejected it.
+ * @param[in] payload Payload piggybacked on the acknowledgment.
+ * @param[in] len     Length of @p payload.
+ */
+typedef void (*coap_con_done_cb_t)(int err, const uint8_t *payload,
+				   uint16_t len);
+
+/** @brief Transmission parameters of confirmable requests.
+ *
+ * The first retransmission waits a random time between ACK_TIMEOUT and
+ * 1.5 * ACK_TIMEOUT, every following one twice as long as the previous.
+ */
+const otCoapTxParameters *coap_con_tx_parameters(void);
+
+/** @brief Send a confirmable PUT.
+ *
+ * @param[in] peer     Address of the peer.
+ * @param[in] uri_path URI path of the resource.
+ * @param[in] payload  Payload, copied into the request.
+ * @param[in] len      Length of the payload.
+ * @param[in] done     Completion callback, may be NULL.
+ *
+ * @retval 0 if the request was sent, negative error code otherwise.
+ */
+int coap_con_put(const struct sockaddr_in6 *peer, const char *uri_path,
+		 const uint8_t *payload, size_t len, coap_con_done_cb_t done);
+
+#endif
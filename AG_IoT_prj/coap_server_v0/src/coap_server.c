@@ -12,7 +12,12 @@
 #include <zephyr/modbus/modbus.h>
 #include <zephyr/pm/device.h>
 
+#include "modbus_poll.h"
 #include "ot_coap_utils.h"
+#include "poll_control.h"
+#include "sample_store.h"
+#include "sensor_resource.h"
+#include "sync_sample.h"
 
 // LOG_MODULE_REGISTER(coap_server, CONFIG_COAP_SERVER_LOG_LEVEL);
 LOG_MODULE_REGISTER(coap_server, LOG_LEVEL_INF);
@@ -47,28 +52,69 @@ struct modbus_iface_param client_param = {
 	},
 };
 uint16_t holding_reg[10] = {0};
+/* Uptime in ms of the reading in holding_reg, 0 if there is none */
+int64_t holding_reg_time;
+
+uint16_t modbus_uid_SED 	= 0x01;
+
+/* Registers of the soil sensor, holding_reg[i + 1] keeps sensor_slots[i] */
+static const struct modbus_scan_slot sensor_slots[] = {
+	{ .name = "ch1", .addr = 0x06 },
+	{ .name = "ch2", .addr = 0x07 },
+	{ .name = "ch3", .addr = 0x08 },
+	{ .name = "ch4", .addr = 0x09 },
+	{ .name = "ch5", .addr = 0x1E },
+	{ .name = "ch6", .addr = 0x1F },
+	{ .name = "ch7", .addr = 0x20 },
+};
+const uint8_t sensor_num_values = ARRAY_SIZE(sensor_slots);
+
+/* Servers on the RS-485 bus, add one entry per sensor */
+static struct modbus_poll_entry poll_table[] = {
+	{
+		.unit_id = 0x01,
+		.slots = sensor_slots,
+		.num_slots = ARRAY_SIZE(sensor_slots),
+		.period_ms = CONFIG_COAP_SERVER_POLL_PERIOD_MS,
+		.priority = 0,
+	},
+};
 
 int init_modbus_client(void)
 {
 	const char iface_name[] = {DEVICE_DT_NAME(MODBUS_NODE)};
+	int err;
+
 	client_iface = modbus_iface_get_by_name(iface_name);
-	return modbus_init_client(client_iface, client_param);
+	err = modbus_init_client(client_iface, client_param);
+	if (err) {
+		return err;
+	}
+
+	err = modbus_poll_init(client_iface, poll_table, ARRAY_SIZE(poll_table),
+			       CONFIG_COAP_SERVER_SCAN_MAX_GAP);
+	if (err) {
+		return err;
+	}
+
+	modbus_poll_start();
+
+	return 0;
 }
-uint16_t modbus_uid_SED 	= 0x01;
-uint16_t reg_adr_SED[7] 	= {0x06, 0x07, 0x08, 0x09, 0x1E, 0x1F, 0x20};
-uint16_t reg_qty_SED 		= 1;
 
 void read_sensor_data(void){
-	uint8_t err;
-	for (int i=0; i<7; i++){
-		LOG_INF("%d",i);
-		err = modbus_read_holding_regs(client_iface,modbus_uid_SED,reg_adr_SED[i],holding_reg,reg_qty_SED);
-		if (err != 0) {
-			LOG_ERR("FC03 failed with %d", err);
-			return;
-		}
-		holding_reg[i+1] = holding_reg[0];
-		LOG_INF("%d: %x;\n",reg_adr_SED[i],holding_reg[i+1]);
+	int err;
+
+	err = modbus_poll_read(modbus_uid_SED, &holding_reg[1],
+			       ARRAY_SIZE(sensor_slots), &holding_reg_time);
+	if (err < 0) {
+		LOG_ERR("No data of unit %u (%d)", modbus_uid_SED, err);
+		holding_reg_time = 0;
+		return;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(sensor_slots); i++) {
+		LOG_INF("%d: %x;", sensor_slots[i].addr, holding_reg[i + 1]);
 	}
 	holding_reg[0] = modbus_uid_SED;
 }
@@ -185,6 +231,8 @@ static void on_thread_state_changed(otChangedFlags flags, struct openthread_cont
 		case OT_DEVICE_ROLE_LEADER:
 			dk_set_led_on(OT_CONNECTION_LED);
 			is_connected = true;
+			poll_control_activity();
+			ot_coap_upload_backlog();
 			break;
 
 		case OT_DEVICE_ROLE_DISABLED:
@@ -239,12 +287,31 @@ int main(void)
 		goto end;
 	}
 
+	ret = sample_store_init();
+	if (ret) {
+		LOG_ERR("Cannot init sample store (error: %d)", ret);
+	}
+
 	LOG_INF("start ot coap init function");
 	ret = ot_coap_init(&deactivate_provisionig, &on_light_request);
 	if (ret) {
 		LOG_ERR("Could not initialize OpenThread CoAP");
 		goto end;
 	}
+
+	ret = sensor_resource_init(modbus_uid_SED, ARRAY_SIZE(sensor_slots));
+	if (ret) {
+		LOG_ERR("Could not initialize sensor resource (error: %d)", ret);
+		goto end;
+	}
+
+	ret = sync_sample_init(modbus_uid_SED, ARRAY_SIZE(sensor_slots));
+	if (ret) {
+		LOG_ERR("Could not initialize sample resource (error: %d)", ret);
+		goto end;
+	}
+
+	poll_control_init();
 	coap_client_utils_init(on_mtd_mode_toggle);
 	LOG_INF("1");
 	openthread_state_changed_cb_register(openthread_get_default_context(), &ot_state_chaged_cb);
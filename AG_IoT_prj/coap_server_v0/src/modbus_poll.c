@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <modbus_ext.h>
+
+#include "modbus_poll.h"
+
+LOG_MODULE_REGISTER(modbus_poll, LOG_LEVEL_INF);
+
+#define MODBUS_POLL_STACK_SIZE 1536
+#define MODBUS_POLL_PRIORITY 6
+
+K_THREAD_STACK_DEFINE(modbus_poll_stack_area, MODBUS_POLL_STACK_SIZE);
+static struct k_thread modbus_poll_thread_data;
+
+/* Protects the result cache of the entries */
+static K_MUTEX_DEFINE(poll_lock);
+
+static struct modbus_poll_entry *poll_entries;
+static size_t poll_num_entries;
+static int poll_iface;
+static modbus_poll_cb_t poll_cb;
+/* One bit per entry polled out of its period */
+static atomic_t poll_triggered;
+/* Wakes the polling thread up once bits are set in poll_triggered */
+static K_SEM_DEFINE(poll_wake, 0, 1);
+
+/* Protects the sampling session state */
+static K_MUTEX_DEFINE(session_lock);
+
+static unsigned int session_open;
+static int64_t session_start;
+static struct modbus_poll_power_stats power_stats;
+
+int modbus_poll_init(int iface, struct modbus_poll_entry *entries,
+		     size_t num_entries, uint16_t max_gap)
+{
+	int err;
+
+	if (num_entries > ATOMIC_BITS) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < num_entries; i++) {
+		struct modbus_poll_entry *entry = &entries[i];
+
+		if (entry->period_ms == 0) {
+			return -EINVAL;
+		}
+
+		err = modbus_scan_plan_build(&entry->plan, entry->slots,
+					     entry->num_slots, max_gap);
+		if (err) {
+			return err;
+		}
+
+		entry->next_due = 0;
+		entry->backoff_ms = 0;
+		entry->trigger_cb = NULL;
+		entry->timestamp = 0;
+		entry->err = -ENODATA;
+
+		LOG_INF("Unit %u: %u registers in %u transactions every %u ms",
+			entry->unit_id, entry->num_slots,
+			entry->plan.num_blocks, entry->period_ms);
+	}
+
+	poll_iface = iface;
+	poll_entries = entries;
+	poll_num_entries = num_entries;
+
+	return 0;
+}
+
+/* Earliest deadline first, the priority decides between equal deadlines. */
+static struct modbus_poll_entry *next_entry(void)
+{
+	struct modbus_poll_entry *next = NULL;
+
+	for (size_t i = 0; i < poll_num_entries; i++) {
+		struct modbus_poll_entry *entry = &poll_entries[i];
+
+		if (next == NULL || entry->next_due < next->next_due ||
+		    (entry->next_due == next->next_due &&
+		     entry->priority < next->priority)) {
+			next = entry;
+		}
+	}
+
+	return next;
+}
+
+static void poll_entry(struct modbus_poll_entry *entry)
+{
+	uint16_t values[MODBUS_SCAN_MAX_SLOTS];
+	modbus_poll_cb_t trigger_cb;
+	int64_t now;
+	int err;
+
+	err = modbus_scan_plan_run(&entry->plan, poll_iface, entry->unit_id,
+				   values);
+	now = k_uptime_get();
+
+	k_mutex_lock(&poll_lock, K_FOREVER);
+	entry->err = err;
+	if (err == 0) {
+		memcpy(entry->values, values,
+		       entry->num_slots * sizeof(values[0]));
+		entry->timestamp = now;
+	}
+	trigger_cb = entry->trigger_cb;
+	entry->trigger_cb = NULL;
+	k_mutex_unlock(&poll_lock);
+
+	if (err == 0 && poll_cb != NULL) {
+		poll_cb(entry->unit_id);
+	}
+
+	if (err == 0 && trigger_cb != NULL) {
+		trigger_cb(entry->unit_id);
+	}
+
+	if (err == -ETIMEDOUT || err == -EHOSTDOWN) {
+		/* Server does not answer, do not waste bus time on it */
+		entry->backoff_ms = MIN(MAX(2 * entry->backoff_ms,
+					    entry->period_ms),
+					CONFIG_COAP_SERVER_POLL_BACKOFF_MAX_MS);
+		LOG_WRN("Unit %u timed out, next poll in %u ms",
+			entry->unit_id, entry->period_ms + entry->backoff_ms);
+	} else {
+		if (err != 0) {
+			LOG_ERR("Unit %u read failed with %d", entry->unit_id,
+				err);
+		}
+
+		entry->backoff_ms = 0;
+	}
+
+	entry->next_due += entry->period_ms + entry->backoff_ms;
+	if (entry->next_due < now) {
+		/* Overloaded bus, skip the missed periods */
+		entry->next_due = now;
+	}
+}
+
+int modbus_poll_session_begin(void)
+{
+	int err = 0;
+
+	if (!IS_ENABLED(CONFIG_COAP_SERVER_MODBUS_SLEEP)) {
+		return 0;
+	}
+
+	k_mutex_lock(&session_lock, K_FOREVER);
+
+	if (session_open > 0) {
+		goto out;
+	}
+
+	err = modbus_iface_resume(poll_iface);
+	if (err == -EALREADY) {
+		err = 0;
+	}
+
+	if (err) {
+		LOG_ERR("Cannot power up the Modbus line (%d)", err);
+		goto out;
+	}
+
+	session_start = k_uptime_get();
+	power_stats.sessions++;
+
+	/* Other sessions wait with the lock until the sensor is ready */
+	k_sleep(K_MSEC(CONFIG_COAP_SERVER_SENSOR_WARMUP_MS));
+
+out:
+	if (err == 0) {
+		session_open++;
+	}
+
+	k_mutex_unlock(&session_lock);
+
+	return err;
+}
+
+void modbus_poll_session_end(void)
+{
+	int err;
+
+	if (!IS_ENABLED(CONFIG_COAP_SERVER_MODBUS_SLEEP)) {
+		return;
+	}
+
+	k_mutex_lock(&session_lock, K_FOREVER);
+
+	if (session_open == 0 || --session_open > 0) {
+		goto out;
+	}
+
+	err = modbus_iface_suspend(poll_iface);
+	if (err && err != -EALREADY) {
+		LOG_WRN("Cannot power down the Modbus line (%d)", err);
+	}
+
+	power_stats.awake_ms += k_uptime_get() - session_start;
+
+out:
+	k_mutex_unlock(&session_lock);
+}
+
+void modbus_poll_power_stats_get(struct modbus_poll_power_stats *stats)
+{
+	k_mutex_lock(&session_lock, K_FOREVER);
+	*stats = power_stats;
+	if (session_open > 0) {
+		stats->awake_ms += k_uptime_get() - session_start;
+	}
+	k_mutex_unlock(&session_lock);
+}
+
+static void modbus_poll_thread(void *p1, void *p2, void *p3)
+{
+	struct modbus_poll_entry *entry;
+	atomic_val_t triggered;
+	int64_t now;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	for (;;) {
+		now = k_uptime_get();
+		triggered = atomic_clear(&poll_triggered);
+
+		for (size_t i = 0; i < poll_num_entries; i++) {
+			if (triggered & BIT(i)) {
+				poll_entries[i].next_due = now;
+			}
+		}
+
+		entry = next_entry();
+		if (entry == NULL) {
+			return;
+		}
+
+		if (entry->next_due > now) {
+			/* A trigger given since the bits were cleared ends
+			 * the wait at once
+			 */
+			(void)k_sem_take(&poll_wake,
+					 K_MSEC(entry->next_due - now));
+			continue;
+		}
+
+		if (modbus_poll_session_begin()) {
+			entry->next_due = now + entry->period_ms;
+			continue;
+		}
+
+		/* Serve every entry due while the line is powered */
+		do {
+			poll_entry(entry);
+			entry = next_entry();
+		} while (entry->next_due <= k_uptime_get());
+
+		modbus_poll_session_end();
+	}
+}
+
+void modbus_poll_start(void)
+{
+	int err;
+
+	if (IS_ENABLED(CONFIG_COAP_SERVER_MODBUS_SLEEP)) {
+		/* Powered by the sampling sessions from now on */
+		err = modbus_iface_suspend(poll_iface);
+		if (err) {
+			LOG_WRN("Cannot power down the Modbus line (%d)", err);
+		}
+	}
+
+	k_thread_create(&modbus_poll_thread_data, modbus_poll_stack_area,
+			K_THREAD_STACK_SIZEOF(modbus_poll_stack_area),
+			modbus_poll_thread, NULL, NULL, NULL,
+			MODBUS_POLL_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&modbus_poll_thread_data, "modbus_poll");
+}
+
+void modbus_poll_set_callback(modbus_poll_cb_t cb)
+{
+	poll_cb = cb;
+}
+
+int modbus_poll_trigger(uint8_t unit_id, modbus_poll_cb_t done)
+{
+	for (size_t i = 0; i < poll_num_entries; i++) {
+		if (poll_entries[i].unit_id != unit_id) {
+			continue;
+		}
+
+		k_mutex_lock(&poll_lock, K_FOREVER);
+		poll_entries[i].trigger_cb = done;
+		k_mutex_unlock(&poll_lock);
+
+		atomic_set_bit(&poll_triggered, i);
+		k_sem_give(&poll_wake);
+
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+int modbus_poll_read(uint8_t unit_id, uint16_t *values, size_t num_values,
+		     int64_t *timestamp)
+{
+	struct modbus_poll_entry *entry = NULL;
+	int ret;
+
+	for (size_t i = 0; i < poll_num_entries; i++) {
+		if (poll_entries[i].unit_id == unit_id) {
+			entry = &poll_entries[i];
+			break;
+		}
+	}
+
+	if (entry == NULL) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&poll_lock, K_FOREVER);
+	if (entry->err) {
+		/* Values of a server that stopped answering are not current */
+		ret = entry->err;
+	} else {
+		ret = MIN(num_values, entry->num_slots);
+		memcpy(values, entry->values, ret * sizeof(values[0]));
+		if (timestamp != NULL) {
+			*timestamp = entry->timestamp;
+		}
+	}
+	k_mutex_unlock(&poll_lock);
+
+	return ret;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __MODBUS_POLL_H__
+#define __MODBUS_POLL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "modbus_scan.h"
+
+/** @brief Type of the function called after a successful read.
+ *
+ * @param[in] unit_id Unit ID of the server read.
+ */
+typedef void (*modbus_poll_cb_t)(uint8_t unit_id);
+
+/**@brief One Modbus server polled periodically by the scheduler.
+ *
+ * The members up to @a priority are set by the application, the rest is
+ * owned by the scheduler and holds the result cache of the entry.
+ */
+struct modbus_poll_entry {
+	/** Unit ID of the server */
+	uint8_t unit_id;
+	/** Holding registers to read */
+	const struct modbus_scan_slot *slots;
+	size_t num_slots;
+	/** Polling period in milliseconds */
+	uint32_t period_ms;
+	/** Lower value is polled first when several entries are due */
+	uint8_t priority;
+
+	struct modbus_scan_plan plan;
+	int64_t next_due;
+	uint32_t backoff_ms;
+	modbus_poll_cb_t trigger_cb;
+	int64_t timestamp;
+	int err;
+	uint16_t values[MODBUS_SCAN_MAX_SLOTS];
+};
+
+/** Power statistics of the Modbus line */
+struct modbus_poll_power_stats {
+	/** Number of sampling sessions */
+	uint32_t sessions;
+	/** Time the line was powered by sessions, in milliseconds */
+	uint64_t awake_ms;
+};
+
+/** @brief Build the scan plans of the polling table.
+ *
+ * @param[in] iface       Modbus client interface index.
+ * @param[in] entries     Polling table, kept by the scheduler.
+ * @param[in] num_entries Number of entries in @p entries.
+ * @param[in] max_gap     Maximum register gap bridged by one read.
+ *
+ * @retval 0 on success, negative error code otherwise.
+ */
+int modbus_poll_init(int iface, struct modbus_poll_entry *entries,
+		     size_t num_entries, uint16_t max_gap);
+
+/** @brief Start the polling thread.
+ */
+void modbus_poll_start(void);
+
+/** @brief Set the function called from the polling thread whenever new
+ *         values are stored in the cache.
+ *
+ * @param[in] cb Callback, NULL to remove it.
+ */
+void modbus_poll_set_callback(modbus_poll_cb_t cb);
+
+/** @brief Poll a server now, ahead of its period.
+ *
+ * The period of the server restarts with this read.
+ *
+ * @param[in] unit_id Unit ID of the server.
+ * @param[in] done    Called from the polling thread once the server was
+ *                    read successfully, may be NULL.
+ *
+ * @retval 0 on success, -ENOENT if the unit is not polled.
+ */
+int modbus_poll_trigger(uint8_t unit_id, modbus_poll_cb_t done);
+
+/** @brief Copy the last values read from a server out of the cache.
+ *
+ * @param[in]  unit_id    Unit ID of the server.
+ * @param[out] values     One value per slot, in the order of the slot table.
+ * @param[in]  num_values Size of @p values.
+ * @param[out] timestamp  Uptime in ms of the read, may be NULL.
+ *
+ * @retval Number of values copied, -ENOENT if the unit is not polled,
+ *         -ENODATA if it has not been read successfully yet, the error of
+ *         the last poll if it failed.
+ */
+int modbus_poll_read(uint8_t unit_id, uint16_t *values, size_t num_values,
+		     int64_t *timestamp);
+
+/** @brief Power up the Modbus line for a sampling session.
+ *
+ * The first open session resumes the UART, enables the RS-485 receiver
+ * and waits the sensor warm-up time. Sessions can be nested, the polling
+ * thread opens one around every scan.
+ *
+ * @retval 0 on success, negative error code if the line did not power up.
+ *         A failed session must not be ended.
+ */
+int modbus_poll_session_begin(void);
+
+/** @brief End a sampling session.
+ *
+ * The last session to end suspends the UART and releases the RS-485
+ * transceiver.
+ */
+void modbus_poll_session_end(void);
+
+/** @brief Get the power statistics of the Modbus line.
+ *
+ * @param[out] stats Statistics.
+ */
+void modbus_poll_power_stats_get(struct modbus_poll_power_stats *stats);
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/modbus/modbus.h>
+
+#include "modbus_scan.h"
+
+LOG_MODULE_REGISTER(modbus_scan, LOG_LEVEL_INF);
+
+int modbus_scan_plan_build(struct modbus_scan_plan *plan,
+			   const struct modbus_scan_slot *slots,
+			   size_t num_slots, uint16_t max_gap)
+{
+	uint16_t addr[MODBUS_SCAN_MAX_SLOTS];
+	struct modbus_scan_block *block;
+
+	if (num_slots == 0 || num_slots > MODBUS_SCAN_MAX_SLOTS) {
+		return -EINVAL;
+	}
+
+	/* Sort a copy of the wanted addresses, the slot table keeps its order */
+	for (size_t i = 0; i < num_slots; i++) {
+		size_t j = i;
+
+		while (j > 0 && addr[j - 1] > slots[i].addr) {
+			addr[j] = addr[j - 1];
+			j--;
+		}
+
+		addr[j] = slots[i].addr;
+	}
+
+	plan->slots = slots;
+	plan->num_slots = num_slots;
+	plan->num_blocks = 1;
+
+	block = &plan->blocks[0];
+	block->start_addr = addr[0];
+	block->num_regs = 1;
+
+	for (size_t i = 1; i < num_slots; i++) {
+		uint32_t end = block->start_addr + block->num_regs;
+		uint32_t span = addr[i] - block->start_addr + 1;
+
+		if (addr[i] < end) {
+			/* Same register wanted twice */
+			continue;
+		}
+
+		if ((addr[i] - end) <= max_gap && span <= MODBUS_SCAN_MAX_REGS) {
+			block->num_regs = span;
+			continue;
+		}
+
+		block = &plan->blocks[plan->num_blocks++];
+		block->start_addr = addr[i];
+		block->num_regs = 1;
+	}
+
+	for (size_t i = 0; i < plan->num_blocks; i++) {
+		LOG_DBG("Block %u: addr 0x%04x, %u registers", i,
+			plan->blocks[i].start_addr, plan->blocks[i].num_regs);
+	}
+
+	return 0;
+}
+
+static bool block_has_slot(const struct modbus_scan_block *block,
+			   const struct modbus_scan_slot *slot)
+{
+	return slot->addr >= block->start_addr &&
+	       slot->addr < block->start_addr + block->num_regs;
+}
+
+/*
+ * A coalesced block may span registers the server does not implement.
+ * Read the wanted registers of such block one by one instead.
+ */
+static int scan_block_fallback(const struct modbus_scan_plan *plan,
+			       const struct modbus_scan_block *block,
+			       int iface, uint8_t unit_id, uint16_t *values)
+{
+	int err;
+
+	for (size_t i = 0; i < plan->num_slots; i++) {
+		const struct modbus_scan_slot *slot = &plan->slots[i];
+
+		if (!block_has_slot(block, slot)) {
+			continue;
+		}
+
+		err = modbus_read_holding_regs(iface, unit_id, slot->addr,
+					       &values[i], 1);
+		if (err != 0) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int modbus_scan_plan_run(const struct modbus_scan_plan *plan, int iface,
+			 uint8_t unit_id, uint16_t *values)
+{
+	uint16_t regs[MODBUS_SCAN_MAX_REGS];
+	int err;
+
+	for (size_t b = 0; b < plan->num_blocks; b++) {
+		const struct modbus_scan_block *block = &plan->blocks[b];
+
+		err = modbus_read_holding_regs(iface, unit_id, block->start_addr,
+					       regs, block->num_regs);
+		if (err == MODBUS_EXC_ILLEGAL_DATA_ADDR && block->num_regs > 1) {
+			LOG_WRN("Block at 0x%04x rejected, reading registers singly",
+				block->start_addr);
+			err = scan_block_fallback(plan, block, iface, unit_id, values);
+			if (err != 0) {
+				return err;
+			}
+
+			continue;
+		}
+
+		if (err != 0) {
+			return err;
+		}
+
+		for (size_t i = 0; i < plan->num_slots; i++) {
+			const struct modbus_scan_slot *slot = &plan->slots[i];
+
+			if (block_has_slot(block, slot)) {
+				values[i] = regs[slot->addr - block->start_addr];
+			}
+		}
+	}
+
+	for (size_t i = 0; i < plan->num_slots; i++) {
+		LOG_DBG("%s (0x%04x): 0x%04x", plan->slots[i].name,
+			plan->slots[i].addr, values[i]);
+	}
+
+	return 0;
+}
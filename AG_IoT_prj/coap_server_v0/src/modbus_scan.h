@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __MODBUS_SCAN_H__
+#define __MODBUS_SCAN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+
+/** Maximum number of registers a scan plan can collect. */
+#define MODBUS_SCAN_MAX_SLOTS 16
+
+/** Maximum number of registers read by one FC03 transaction. */
+#define MODBUS_SCAN_MAX_REGS MIN(125, (CONFIG_MODBUS_BUFFER_SIZE - 5) / 2)
+
+/**@brief One named holding register wanted by a scan. */
+struct modbus_scan_slot {
+	const char *name;
+	uint16_t addr;
+};
+
+/**@brief One coalesced FC03 transaction of a scan plan. */
+struct modbus_scan_block {
+	uint16_t start_addr;
+	uint16_t num_regs;
+};
+
+/**@brief Set of FC03 transactions covering all slots of a scan. */
+struct modbus_scan_plan {
+	const struct modbus_scan_slot *slots;
+	size_t num_slots;
+	struct modbus_scan_block blocks[MODBUS_SCAN_MAX_SLOTS];
+	size_t num_blocks;
+};
+
+/** @brief Merge the slot addresses into the fewest FC03 transactions.
+ *
+ * Addresses closer than @p max_gap unused registers are read in one
+ * transaction, the registers in between are read and dropped.
+ *
+ * @param[out] plan      Plan to build.
+ * @param[in]  slots     Registers wanted by the scan, in any order.
+ * @param[in]  num_slots Number of entries in @p slots.
+ * @param[in]  max_gap   Maximum number of unused registers to over-read.
+ *
+ * @retval 0 on success, -EINVAL if there are no slots or too many of them.
+ */
+int modbus_scan_plan_build(struct modbus_scan_plan *plan,
+			   const struct modbus_scan_slot *slots,
+			   size_t num_slots, uint16_t max_gap);
+
+/** @brief Execute a scan plan and scatter the results into the slots.
+ *
+ * @param[in]  plan    Plan built by @ref modbus_scan_plan_build.
+ * @param[in]  iface   Modbus client interface index.
+ * @param[in]  unit_id Modbus unit ID of the server.
+ * @param[out] values  One value per slot, in the order of the slot table.
+ *
+ * @retval 0 on success, error returned by the Modbus client otherwise.
+ */
+int modbus_scan_plan_run(const struct modbus_scan_plan *plan, int iface,
+			 uint8_t unit_id, uint16_t *values);
+
+#endif
@@ -1,4 +1,5 @@
 #include <zephyr/logging/log.h>
+#include <zephyr/random/random.h>
 #include <zephyr/net/socket.h>
 // #include <zephyr/net/net_pkt.h>
 // #include <zephyr/net/net_l2.h>
@@ -10,7 +11,12 @@
 #include <openthread/thread.h>
 #include <coap_server_client_interface.h>
 
+#include "coap_block.h"
+#include "coap_con.h"
 #include "ot_coap_utils.h"
+#include "poll_control.h"
+#include "report_filter.h"
+#include "sample_store.h"
 
 // LOG_MODULE_REGISTER(ot_coap_utils, CONFIG_OT_COAP_UTILS_LOG_LEVEL);
 LOG_MODULE_REGISTER(ot_coap_utils, LOG_LEVEL_ERR);
@@ -22,13 +28,24 @@ K_THREAD_STACK_DEFINE(coap_client_workq_stack_area, COAP_CLIENT_WORKQ_STACK_SIZE
 static struct k_work_q coap_client_workq;
 
 static struct k_work unicast_light_work;
+static struct k_work sed_report_work;
+static struct k_work_delayable backlog_work;
+static struct k_work_delayable batch_flush_work;
+static struct k_work batch_done_work;
+static struct k_work con_done_work;
 static struct k_work multicast_light_work;
 static struct k_work toggle_MTD_SED_work;
 static struct k_work provisioning_work;
+static struct k_work_delayable provisioning_timeout_work;
+
+/* A provisioning request holds the shortest poll period */
+static atomic_t provisioning_pending;
 
 mtd_mode_toggle_cb_t on_mtd_mode_toggle;
 
 extern uint16_t holding_reg[10];
+extern int64_t holding_reg_time;
+extern const uint8_t sensor_num_values;
 
 static struct k_timer sed_timer;
 
@@ -133,31 +150,20 @@ end:
 	return error;
 }
 
-#define RESPONSE_POLL_PERIOD 10000
-
-static bool is_mtd_in_med_mode(otInstance *instance)
+/* The multicast request may be answered more than once, or not at all */
+static void provisioning_expect_end(void)
 {
-	return otThreadGetLinkMode(instance).mRxOnWhenIdle;
+	if (atomic_cas(&provisioning_pending, 1, 0)) {
+		poll_control_expect_end();
+	}
 }
 
-static uint32_t poll_period;
-
-static void poll_period_restore(void)
+static void provisioning_timeout(struct k_work *item)
 {
-	otError error;
-	otInstance *instance = openthread_get_default_instance();
-
-	if (is_mtd_in_med_mode(instance)) {
-		return;
-	}
-
-	if (poll_period) {
-		error = otLinkSetPollPeriod(instance, poll_period);
-		__ASSERT_NO_MSG(error == OT_ERROR_NONE);
+	ARG_UNUSED(item);
 
-		LOG_INF("Poll Period: %dms restored", poll_period);
-		poll_period = 0;
-	}
+	LOG_WRN("No reply to the provisioning request");
+	provisioning_expect_end();
 }
 
 static int on_provisioning_reply(const struct coap_packet *response,
@@ -192,46 +198,37 @@ static int on_provisioning_reply(const struct coap_packet *response,
 	LOG_INF("Received peer address: %s", unique_local_addr_str);
 
 exit:
-	if (IS_ENABLED(CONFIG_OPENTHREAD_MTD_SED)) {
-		poll_period_restore();
-	}
+	k_work_cancel_delayable(&provisioning_timeout_work);
+	provisioning_expect_end();
 
 	return ret;
 }
 
-static void poll_period_response_set(void)
+static void send_provisioning_request(struct k_work *item)
 {
-	otError error;
+	int err;
 
-	otInstance *instance = openthread_get_default_instance();
+	ARG_UNUSED(item);
 
-	if (is_mtd_in_med_mode(instance)) {
-		return;
+	/* Poll fast until the reply arrives or the request times out */
+	if (atomic_cas(&provisioning_pending, 0, 1)) {
+		poll_control_expect_begin();
 	}
 
-	if (!poll_period) {
-		poll_period = otLinkGetPollPeriod(instance);
-
-		error = otLinkSetPollPeriod(instance, RESPONSE_POLL_PERIOD);
-		__ASSERT(error == OT_ERROR_NONE, "Failed to set pool period");
-
-		LOG_INF("Poll Period: %dms set", RESPONSE_POLL_PERIOD);
-	}
-}
-
-static void send_provisioning_request(struct k_work *item)
-{
-	ARG_UNUSED(item);
-	
-	if (IS_ENABLED(CONFIG_OPENTHREAD_MTD_SED)) {
-		/* decrease the polling period for higher responsiveness */
-		poll_period_response_set();
-	}
+	k_work_reschedule_for_queue(&coap_client_workq,
+		&provisioning_timeout_work,
+		K_MSEC(CONFIG_COAP_SERVER_PROVISIONING_TIMEOUT_MS));
 
 	LOG_INF("Send 'provisioning' request");
-	coap_send_request(COAP_METHOD_GET,
-			  (const struct sockaddr *)&multicast_local_addr,
-			  provisioning_option, NULL, 0u, on_provisioning_reply);
+	err = coap_send_request(COAP_METHOD_GET,
+				(const struct sockaddr *)&multicast_local_addr,
+				provisioning_option, NULL, 0u,
+				on_provisioning_reply);
+	if (err < 0) {
+		LOG_ERR("Failed to send provisioning request (%d)", err);
+		k_work_cancel_delayable(&provisioning_timeout_work);
+		provisioning_expect_end();
+	}
 }
 
 static void submit_work_if_connected(struct k_work *work)
@@ -281,6 +278,7 @@ void configure_med_mode(void){
 	config.mNetworkData = true;
 
 	otThreadSetLinkMode(srv_context.ot, config);//set med mode
+	poll_control_activity();
 }
 
 void configure_sed_mode(void){
@@ -291,7 +289,7 @@ void configure_sed_mode(void){
 	config.mNetworkData = true;
 
 	otThreadSetLinkMode(srv_context.ot, config);//set sed mode
-	otLinkSetPollPeriod(srv_context.ot, RESPONSE_POLL_PERIOD);//set sed poll period
+	poll_control_activity();//poll fast, then back off while idle
 }
 
 static bool con_reg;
@@ -300,8 +298,8 @@ static void sed_timer_handler(struct k_timer *timer_id){
 	LOG_INF("Wake up to perform data transmission");
 	// srv_context.on_light_request(THREAD_COAP_UTILS_LIGHT_CMD_TOGGLE);
 	if(unique_local_addr.sin6_addr.s6_addr16[0] != 0){
-		LOG_INF("unicast_light_work submit");
-		k_work_submit_to_queue(&coap_client_workq, &unicast_light_work);
+		LOG_INF("sed_report_work submit");
+		k_work_submit_to_queue(&coap_client_workq, &sed_report_work);
 	}else{
 		LOG_WRN("Peer address not set. Activate 'provisioning' option "
 			"on the server side");
@@ -337,6 +335,8 @@ static void light_request_handler(void *context, otMessage *message,
 
 	LOG_INF("Received light request: %c", command);
 
+	poll_control_activity();
+
 	srv_context.on_light_request(command);
 
 	if(unique_local_addr.sin6_addr.s6_addr16[0] != 0){
@@ -381,19 +381,249 @@ bool ot_coap_is_provisioning_active(void)
 }
 
 
-static void toggle_one_light(struct k_work *item)
+/* Confirmable uplink in flight, kept until it is acknowledged */
+static uint8_t con_tx_buf[MAX(SENSOR_PAYLOAD_MAX_LEN, SENSOR_BATCH_MAX_LEN)];
+static int con_tx_len;
+static int64_t con_tx_time;
+static int con_tx_err;
+static uint8_t con_command;
+
+static void on_con_done(int err, const uint8_t *payload, uint16_t len)
 {
-	if(unique_local_addr.sin6_addr.s6_addr16[0] != 0){
-		srv_context.on_light_request(THREAD_COAP_UTILS_LIGHT_CMD_TOGGLE);
+	con_tx_err = err;
+	/* The peer may piggyback its next light command on the ACK */
+	con_command = (err == 0 && len > 0) ? payload[0] : 0;
+	k_work_submit_to_queue(&coap_client_workq, &con_done_work);
+}
+
+static int sensor_send(const uint8_t *payload, int len)
+{
+	int err;
+
+	LOG_INF("Send 'light' request to: %s", unique_local_addr_str);
+
+	if (!IS_ENABLED(CONFIG_COAP_SERVER_LIGHT_CON)) {
+		return coap_send_request(COAP_METHOD_PUT,
+					 (const struct sockaddr *)&unique_local_addr,
+					 light_option, (uint8_t *)payload, len,
+					 NULL);
+	}
+
+	if (con_tx_len > 0) {
+		/* One reliable uplink at a time, the backlog takes the rest */
+		return -EBUSY;
+	}
+
+	if (len > sizeof(con_tx_buf)) {
+		return -ENOBUFS;
 	}
-	uint8_t payload = (uint8_t)holding_reg[0];
-	LOG_INF("holding_reg[0]= %x", (uint8_t)holding_reg[0]);
-	char reg_char[50];
-	snprintk(reg_char,sizeof(reg_char),"%x,%x,%x,%x,%x,%x,%x,%x",holding_reg[0],holding_reg[1],holding_reg[2],holding_reg[3],holding_reg[4],holding_reg[5],holding_reg[6],holding_reg[7]);
-	LOG_INF("reg_char: %s", reg_char);
 
+	memcpy(con_tx_buf, payload, len);
+	con_tx_len = len;
+	con_tx_time = k_uptime_get();
+
+	/* Fetch the ACK before the retransmission timeout */
+	poll_control_expect_begin();
+
+	err = coap_con_put(&unique_local_addr, LIGHT_URI_PATH, payload, len,
+			   on_con_done);
+	if (err) {
+		con_tx_len = 0;
+		poll_control_expect_end();
+	}
+
+	return err;
+}
+
+static void sample_keep(const struct sensor_sample *samples, size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		sample_store_put(&samples[i]);
+	}
+
+	LOG_INF("Reading stored, %u waiting for upload", sample_store_count());
+}
+
+static uint32_t sample_age(const struct sensor_sample *sample, int64_t now)
+{
+	if (sample->timestamp == SAMPLE_TIME_UNKNOWN) {
+		return SENSOR_BATCH_AGE_UNKNOWN;
+	}
+
+	return MIN(now - sample->timestamp, SENSOR_BATCH_AGE_UNKNOWN - 1);
+}
+
+/* Put the readings of an unacknowledged uplink back into the store */
+static void sample_restore(const uint8_t *payload, int len, int64_t sent)
+{
+	struct sensor_sample sample;
+	size_t offset = SENSOR_BATCH_HDR_LEN;
+	uint32_t age;
+	int num;
+
+	if (payload[0] != SENSOR_BATCH_VERSION) {
+		num = sensor_payload_decode(payload, len, &sample.unit_id,
+					    sample.values,
+					    ARRAY_SIZE(sample.values));
+		if (num >= 0) {
+			sample.timestamp = sent;
+			sample.num_values = num;
+			sample_keep(&sample, 1);
+		}
+
+		return;
+	}
+
+	while ((num = sensor_batch_next(payload, len, &offset, &age,
+					&sample.unit_id, sample.values,
+					ARRAY_SIZE(sample.values))) >= 0) {
+		sample.timestamp = age == SENSOR_BATCH_AGE_UNKNOWN ?
+			SAMPLE_TIME_UNKNOWN : sent - age;
+		sample.num_values = num;
+		sample_keep(&sample, 1);
+	}
+}
+
+static void con_done(struct k_work *item)
+{
+	ARG_UNUSED(item);
+
+	poll_control_expect_end();
+
+	if (con_tx_err) {
+		sample_restore(con_tx_buf, con_tx_len, con_tx_time);
+	} else if (con_command != 0) {
+		LOG_INF("Piggybacked light command: %c", con_command);
+		srv_context.on_light_request(con_command);
+	}
+
+	con_tx_len = 0;
+}
+
+#define BATCH_BUF_LEN (SENSOR_BATCH_HDR_LEN +				\
+		       CONFIG_COAP_SERVER_BATCH_SAMPLES *		\
+		       (SENSOR_BATCH_REC_HDR_LEN + SENSOR_PAYLOAD_MAX_LEN))
+
+/* Readings collected for the next batch */
+static struct sensor_sample batch[CONFIG_COAP_SERVER_BATCH_SAMPLES];
+static size_t batch_count;
+
+/* Batch of the ongoing block-wise transfer */
+static struct sensor_sample batch_tx[CONFIG_COAP_SERVER_BATCH_SAMPLES];
+static size_t batch_tx_count;
+static uint8_t batch_tx_buf[BATCH_BUF_LEN];
+static int batch_tx_err;
+static uint8_t batch_command;
+
+static void batch_done(struct k_work *item)
+{
 	ARG_UNUSED(item);
-	LOG_INF("unique_local_addr.sin6_addr.s6_addr16[0]= %d", unique_local_addr.sin6_addr.s6_addr16[0]);
+
+	poll_control_expect_end();
+
+	if (batch_tx_err) {
+		sample_keep(batch_tx, batch_tx_count);
+	} else if (batch_command != 0) {
+		LOG_INF("Piggybacked light command: %c", batch_command);
+		srv_context.on_light_request(batch_command);
+	}
+
+	batch_tx_count = 0;
+}
+
+static void on_batch_transfer_done(int err, const uint8_t *payload,
+				   uint16_t len)
+{
+	batch_tx_err = err;
+	/* The peer may piggyback its next light command on the last ACK */
+	batch_command = (err == 0 && len > 0) ? payload[0] : 0;
+	k_work_submit_to_queue(&coap_client_workq, &batch_done_work);
+}
+
+/* Send the collected readings in one message, block-wise if they do not
+ * fit into one frame.
+ */
+static void batch_flush(struct k_work *item)
+{
+	int64_t now = k_uptime_get();
+	size_t num = batch_count;
+	int len;
+	int err;
+
+	ARG_UNUSED(item);
+
+	if (num == 0) {
+		return;
+	}
+
+	batch_count = 0;
+
+	if (!is_connected || batch_tx_count > 0) {
+		/* The backlog upload takes over */
+		sample_keep(batch, num);
+		return;
+	}
+
+	len = sensor_batch_init(batch_tx_buf, sizeof(batch_tx_buf));
+	for (size_t i = 0; i < num; i++) {
+		len = sensor_batch_append(batch_tx_buf, sizeof(batch_tx_buf),
+					  len, sample_age(&batch[i], now),
+					  batch[i].unit_id, batch[i].values,
+					  batch[i].num_values);
+		__ASSERT_NO_MSG(len > 0);
+	}
+
+	LOG_INF("Send batch of %u readings, %d bytes", num, len);
+
+	if (len <= SENSOR_BATCH_MAX_LEN) {
+		if (sensor_send(batch_tx_buf, len) < 0) {
+			sample_keep(batch, num);
+		}
+
+		return;
+	}
+
+	memcpy(batch_tx, batch, num * sizeof(batch[0]));
+	batch_tx_count = num;
+
+	/* Every block waits for its 2.31 Continue */
+	poll_control_expect_begin();
+
+	err = coap_block_put(&unique_local_addr, LIGHT_URI_PATH, batch_tx_buf,
+			     len, CONFIG_COAP_SERVER_BLOCK_SZX,
+			     on_batch_transfer_done);
+	if (err) {
+		poll_control_expect_end();
+		LOG_ERR("Failed to start block-wise transfer (%d)", err);
+		sample_keep(batch_tx, batch_tx_count);
+		batch_tx_count = 0;
+	}
+}
+
+static void batch_add(const struct sensor_sample *sample)
+{
+	batch[batch_count++] = *sample;
+
+	if (batch_count == ARRAY_SIZE(batch)) {
+		k_work_reschedule_for_queue(&coap_client_workq,
+					    &batch_flush_work, K_NO_WAIT);
+	} else if (batch_count == 1) {
+		k_work_reschedule_for_queue(&coap_client_workq,
+			&batch_flush_work,
+			K_MSEC(CONFIG_COAP_SERVER_BATCH_TIMEOUT_MS));
+	}
+}
+
+/* Read the sensor and send the values to the provisioned peer. Periodic
+ * reports go through the report-by-exception filter first and are
+ * batched if configured. Readings that cannot be sent are kept for
+ * upload once the mesh is back.
+ */
+static void sensor_report(bool filtered)
+{
+	uint8_t payload[SENSOR_PAYLOAD_MAX_LEN];
+	struct sensor_sample sample;
+	int len;
 
 	if (unique_local_addr.sin6_addr.s6_addr16[0] == 0) {
 		LOG_WRN("Peer address not set. Activate 'provisioning' option "
@@ -401,14 +631,131 @@ static void toggle_one_light(struct k_work *item)
 		return;
 	}
 
-	LOG_INF("Send 'light' request to: %s", unique_local_addr_str);
-	// coap_send_request(COAP_METHOD_PUT,
-	// 		  (const struct sockaddr *)&unique_local_addr,
-	// 		  light_option, &payload, sizeof(payload), NULL);
+	srv_context.on_light_request(THREAD_COAP_UTILS_LIGHT_CMD_TOGGLE);
 
-	coap_send_request(COAP_METHOD_PUT,
-			  (const struct sockaddr *)&unique_local_addr,
-			  light_option, &reg_char, sizeof(reg_char), NULL);
+	if (holding_reg_time == 0) {
+		LOG_WRN("No current sensor reading, not sent");
+		return;
+	}
+
+	if (filtered &&
+	    !report_filter_check(&holding_reg[1], sensor_num_values)) {
+		LOG_DBG("Reading within deadband, not sent");
+		return;
+	}
+
+	/* holding_reg[0] keeps the unit ID, the sensor values follow */
+	sample.timestamp = holding_reg_time;
+	sample.unit_id = (uint8_t)holding_reg[0];
+	sample.num_values = sensor_num_values;
+	memcpy(sample.values, &holding_reg[1],
+	       sensor_num_values * sizeof(sample.values[0]));
+
+	report_filter_update(sample.values, sample.num_values);
+
+	if (filtered && CONFIG_COAP_SERVER_BATCH_SAMPLES > 1) {
+		batch_add(&sample);
+		return;
+	}
+
+	len = sensor_payload_encode(payload, sizeof(payload), sample.unit_id,
+				    sample.values, sample.num_values);
+	if (len < 0) {
+		LOG_ERR("Failed to encode sensor payload (%d)", len);
+		return;
+	}
+
+	LOG_HEXDUMP_INF(payload, len, "Sensor payload:");
+
+	if (!is_connected || sensor_send(payload, len) < 0) {
+		sample_keep(&sample, 1);
+	}
+}
+
+/* Send the stored readings, as many per message as fit into one frame,
+ * one message every CONFIG_COAP_SERVER_UPLOAD_INTERVAL_MS.
+ */
+static void backlog_upload(struct k_work *item)
+{
+	uint8_t payload[SENSOR_BATCH_MAX_LEN];
+	struct sensor_sample sample;
+	int64_t now = k_uptime_get();
+	size_t num = 0;
+	int len;
+	int ret;
+
+	ARG_UNUSED(item);
+
+	if (!is_connected || unique_local_addr.sin6_addr.s6_addr16[0] == 0) {
+		return;
+	}
+
+	len = sensor_batch_init(payload, sizeof(payload));
+
+	while ((ret = sample_store_peek(num, &sample)) != -ENOENT) {
+		if (ret < 0) {
+			if (num > 0) {
+				break;
+			}
+
+			LOG_ERR("Dropping unreadable sample (%d)", ret);
+			sample_store_drop(1);
+			continue;
+		}
+
+		ret = sensor_batch_append(payload, sizeof(payload), len,
+					  sample_age(&sample, now),
+					  sample.unit_id, sample.values,
+					  sample.num_values);
+		if (ret < 0) {
+			break;
+		}
+
+		len = ret;
+		num++;
+	}
+
+	if (num == 0) {
+		return;
+	}
+
+	if (sensor_send(payload, len) < 0) {
+		LOG_WRN("Backlog upload failed, retrying");
+	} else {
+		sample_store_drop(num);
+		LOG_INF("Uploaded %u stored readings, %u left", num,
+			sample_store_count());
+	}
+
+	if (sample_store_count() > 0) {
+		k_work_schedule_for_queue(&coap_client_workq, &backlog_work,
+			K_MSEC(CONFIG_COAP_SERVER_UPLOAD_INTERVAL_MS));
+	}
+}
+
+void ot_coap_upload_backlog(void)
+{
+	if (sample_store_count() == 0) {
+		return;
+	}
+
+	/* Spread the uploads of the nodes that reattach together */
+	k_work_schedule_for_queue(&coap_client_workq, &backlog_work,
+		K_MSEC(sys_rand32_get() % CONFIG_COAP_SERVER_UPLOAD_INTERVAL_MS));
+}
+
+static void toggle_one_light(struct k_work *item)
+{
+	ARG_UNUSED(item);
+
+	sensor_report(false);
+}
+
+static void sed_report(struct k_work *item)
+{
+	ARG_UNUSED(item);
+
+	sensor_report(true);
 }
 
 
@@ -447,6 +794,7 @@ static void toggle_minimal_sleepy_end_device(struct k_work *item)
 	if (error != OT_ERROR_NONE) {
 		LOG_ERR("Failed to set MLE link mode configuration");
 	} else {
+		poll_control_activity();
 		on_mtd_mode_toggle(mode.mRxOnWhenIdle);
 	}
 }
@@ -471,8 +819,14 @@ void coap_client_utils_init(mtd_mode_toggle_cb_t on_toggle)
 	LOG_INF("add different work in coap client quene ");
 
 	k_work_init(&unicast_light_work, toggle_one_light);
+	k_work_init(&sed_report_work, sed_report);
+	k_work_init_delayable(&backlog_work, backlog_upload);
+	k_work_init_delayable(&batch_flush_work, batch_flush);
+	k_work_init(&batch_done_work, batch_done);
+	k_work_init(&con_done_work, con_done);
 	k_work_init(&multicast_light_work, toggle_mesh_lights);
 	k_work_init(&provisioning_work, send_provisioning_request);
+	k_work_init_delayable(&provisioning_timeout_work, provisioning_timeout);
 
 	if (IS_ENABLED(CONFIG_OPENTHREAD_MTD_SED)) {
 		k_work_init(&toggle_MTD_SED_work,
@@ -71,4 +71,10 @@ void ot_coap_activate_provisioning(void);
 void ot_coap_deactivate_provisioning(void);
 
 bool ot_coap_is_provisioning_active(void);
+
+/** @brief Start uploading the readings stored while the mesh was down.
+ *
+ * @note Call once the node is attached again.
+ */
+void ot_coap_upload_backlog(void);
 #endif
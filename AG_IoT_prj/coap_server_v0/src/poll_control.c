@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/openthread.h>
+#include <zephyr/shell/shell.h>
+#include <openthread/link.h>
+#include <openthread/thread.h>
+
+#include "poll_control.h"
+
+LOG_MODULE_REGISTER(poll_control, LOG_LEVEL_INF);
+
+#define POLL_BACKOFF_FACTOR 2
+
+BUILD_ASSERT(CONFIG_COAP_SERVER_SED_POLL_MIN_MS <=
+	     CONFIG_COAP_SERVER_SED_POLL_MAX_MS,
+	     "Minimum poll period above the maximum");
+
+/* Accessed with the OpenThread API mutex held only */
+static struct {
+	uint32_t period;
+	uint32_t max_period;
+	uint32_t expected;
+	bool sleepy;
+	int64_t since;
+	/* Data polls, in 1/1000 of a poll */
+	uint64_t polls_milli;
+	uint64_t sleepy_ms;
+} ctrl;
+
+static struct k_work_delayable idle_work;
+
+static void stats_account(int64_t now)
+{
+	int64_t elapsed = now - ctrl.since;
+
+	if (ctrl.sleepy) {
+		ctrl.sleepy_ms += elapsed;
+		ctrl.polls_milli += elapsed * 1000 / ctrl.period;
+	}
+
+	ctrl.since = now;
+}
+
+static void period_apply(otInstance *instance, uint32_t period)
+{
+	otError error;
+
+	stats_account(k_uptime_get());
+
+	/* The period of a device that keeps its receiver on is not used,
+	 * it is applied once the device becomes sleepy again.
+	 */
+	ctrl.sleepy = !otThreadGetLinkMode(instance).mRxOnWhenIdle;
+
+	if (period != ctrl.period) {
+		LOG_DBG("Poll period: %u ms", period);
+		ctrl.period = period;
+	}
+
+	if (!ctrl.sleepy) {
+		return;
+	}
+
+	error = otLinkSetPollPeriod(instance, period);
+	if (error != OT_ERROR_NONE) {
+		LOG_WRN("Failed to set poll period %u ms: %d", period, error);
+	}
+}
+
+static void burst_start(otInstance *instance)
+{
+	period_apply(instance, CONFIG_COAP_SERVER_SED_POLL_MIN_MS);
+
+	if (ctrl.expected == 0) {
+		k_work_reschedule(&idle_work,
+				  K_MSEC(CONFIG_COAP_SERVER_SED_POLL_BURST_MS));
+	}
+}
+
+static void poll_idle(struct k_work *item)
+{
+	struct openthread_context *context = openthread_get_default_context();
+	uint32_t period;
+
+	ARG_UNUSED(item);
+
+	openthread_api_mutex_lock(context);
+
+	if (ctrl.expected > 0) {
+		goto out;
+	}
+
+	period = MIN(ctrl.period * POLL_BACKOFF_FACTOR, ctrl.max_period);
+	period_apply(context->instance, period);
+
+	if (period < ctrl.max_period) {
+		k_work_reschedule(&idle_work, K_MSEC(period));
+	}
+
+out:
+	openthread_api_mutex_unlock(context);
+}
+
+void poll_control_activity(void)
+{
+	struct openthread_context *context = openthread_get_default_context();
+
+	openthread_api_mutex_lock(context);
+	burst_start(context->instance);
+	openthread_api_mutex_unlock(context);
+}
+
+void poll_control_expect_begin(void)
+{
+	struct openthread_context *context = openthread_get_default_context();
+
+	openthread_api_mutex_lock(context);
+
+	ctrl.expected++;
+	k_work_cancel_delayable(&idle_work);
+	period_apply(context->instance, CONFIG_COAP_SERVER_SED_POLL_MIN_MS);
+
+	openthread_api_mutex_unlock(context);
+}
+
+void poll_control_expect_end(void)
+{
+	struct openthread_context *context = openthread_get_default_context();
+
+	openthread_api_mutex_lock(context);
+
+	if (ctrl.expected > 0) {
+		ctrl.expected--;
+	}
+
+	/* A response is often followed by more traffic */
+	if (ctrl.expected == 0) {
+		burst_start(context->instance);
+	}
+
+	openthread_api_mutex_unlock(context);
+}
+
+void poll_control_stats_get(struct poll_control_stats *stats)
+{
+	struct openthread_context *context = openthread_get_default_context();
+
+	openthread_api_mutex_lock(context);
+
+	stats_account(k_uptime_get());
+
+	stats->period_ms = ctrl.period;
+	stats->polls = ctrl.polls_milli / 1000;
+	stats->sleepy_ms = ctrl.sleepy_ms;
+	stats->avg_period_ms = stats->polls > 0 ?
+		ctrl.sleepy_ms / stats->polls : 0;
+	stats->duty_ppm = ctrl.sleepy_ms > 0 ?
+		ctrl.polls_milli * CONFIG_COAP_SERVER_SED_POLL_RX_US /
+		ctrl.sleepy_ms : 0;
+
+	openthread_api_mutex_unlock(context);
+}
+
+void poll_control_stats_reset(void)
+{
+	struct openthread_context *context = openthread_get_default_context();
+
+	openthread_api_mutex_lock(context);
+
+	ctrl.since = k_uptime_get();
+	ctrl.polls_milli = 0;
+	ctrl.sleepy_ms = 0;
+
+	openthread_api_mutex_unlock(context);
+}
+
+void poll_control_init(void)
+{
+	struct openthread_context *context = openthread_get_default_context();
+	uint32_t child_timeout_ms;
+
+	k_work_init_delayable(&idle_work, poll_idle);
+
+	openthread_api_mutex_lock(context);
+
+	child_timeout_ms = otThreadGetChildTimeout(context->instance) *
+			   MSEC_PER_SEC;
+	ctrl.max_period = CLAMP(child_timeout_ms / 2,
+				CONFIG_COAP_SERVER_SED_POLL_MIN_MS,
+				CONFIG_COAP_SERVER_SED_POLL_MAX_MS);
+	ctrl.period = ctrl.max_period;
+	ctrl.since = k_uptime_get();
+
+	/* Start fast, the attach is followed by the backlog upload */
+	burst_start(context->instance);
+
+	openthread_api_mutex_unlock(context);
+
+	LOG_INF("Poll period %u..%u ms", CONFIG_COAP_SERVER_SED_POLL_MIN_MS,
+		ctrl.max_period);
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_show(const struct shell *sh, size_t argc, char **argv)
+{
+	struct poll_control_stats stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	poll_control_stats_get(&stats);
+
+	shell_print(sh, "period %u ms, max %u ms", stats.period_ms,
+		    ctrl.max_period);
+	shell_print(sh, "%u polls in %u s sleepy, average period %u ms",
+		    stats.polls, (uint32_t)(stats.sleepy_ms / MSEC_PER_SEC),
+		    stats.avg_period_ms);
+	shell_print(sh, "receive duty cycle %u ppm", stats.duty_ppm);
+
+	return 0;
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(sh);
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	poll_control_stats_reset();
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sedpoll_cmds,
+	SHELL_CMD(show, NULL, "Show polling statistics", cmd_show),
+	SHELL_CMD(reset, NULL, "Reset polling statistics", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(sedpoll, &sedpoll_cmds, "Sleepy end device polling",
+		   NULL);
+#endif
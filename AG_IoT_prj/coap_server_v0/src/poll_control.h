@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __POLL_CONTROL_H__
+#define __POLL_CONTROL_H__
+
+#include <stdint.h>
+
+/** Polling statistics of the sleepy end device */
+struct poll_control_stats {
+	/** Current poll period, in milliseconds */
+	uint32_t period_ms;
+	/** Data polls estimated since the statistics were reset */
+	uint32_t polls;
+	/** Time spent in sleepy mode since the reset, in milliseconds */
+	uint64_t sleepy_ms;
+	/** Average poll period over @ref sleepy_ms, in milliseconds */
+	uint32_t avg_period_ms;
+	/** Estimated radio receive duty cycle, in parts per million */
+	uint32_t duty_ppm;
+};
+
+/** @brief Initialize the poll period controller.
+ *
+ * The maximum poll period is limited to half the child timeout, so a
+ * node that misses one poll is not dropped by its parent.
+ */
+void poll_control_init(void);
+
+/** @brief Report traffic to or from the device.
+ *
+ * Polls at the minimum period for the burst hold time, after which the
+ * period doubles on every idle poll until it reaches the maximum.
+ */
+void poll_control_activity(void);
+
+/** @brief Mark the start of a request whose response has to be fetched.
+ *
+ * Polls at the minimum period until every expected response ended with
+ * @ref poll_control_expect_end.
+ */
+void poll_control_expect_begin(void);
+
+/** @brief Mark the end of a request started with
+ *         @ref poll_control_expect_begin, answered or not.
+ */
+void poll_control_expect_end(void);
+
+/** @brief Get the polling statistics.
+ *
+ * @param[out] stats Statistics.
+ */
+void poll_control_stats_get(struct poll_control_stats *stats);
+
+/** @brief Restart the polling statistics. */
+void poll_control_stats_reset(void);
+
+#endif
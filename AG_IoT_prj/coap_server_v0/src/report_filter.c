@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+
+#include "report_filter.h"
+
+LOG_MODULE_REGISTER(report_filter, LOG_LEVEL_INF);
+
+struct report_deadband {
+	uint16_t abs;
+	uint16_t rel_permille;
+};
+
+static K_MUTEX_DEFINE(filter_lock);
+
+static struct report_deadband deadband[REPORT_FILTER_MAX_CHANNELS] = {
+	[0 ... REPORT_FILTER_MAX_CHANNELS - 1] = {
+		.abs = CONFIG_COAP_SERVER_REPORT_DEADBAND_ABS,
+		.rel_permille = CONFIG_COAP_SERVER_REPORT_DEADBAND_REL,
+	},
+};
+static uint32_t filter_min_interval_ms = CONFIG_COAP_SERVER_REPORT_MIN_INTERVAL_MS;
+static uint32_t filter_max_silence_ms = CONFIG_COAP_SERVER_REPORT_MAX_SILENCE_MS;
+
+static uint16_t last_values[REPORT_FILTER_MAX_CHANNELS];
+static size_t last_num_values;
+static int64_t last_report;
+
+int report_filter_set_deadband(size_t channel, uint16_t abs,
+			       uint16_t rel_permille)
+{
+	if (channel >= REPORT_FILTER_MAX_CHANNELS) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&filter_lock, K_FOREVER);
+	deadband[channel].abs = abs;
+	deadband[channel].rel_permille = rel_permille;
+	k_mutex_unlock(&filter_lock);
+
+	return 0;
+}
+
+void report_filter_set_intervals(uint32_t min_interval_ms,
+				 uint32_t max_silence_ms)
+{
+	k_mutex_lock(&filter_lock, K_FOREVER);
+	filter_min_interval_ms = min_interval_ms;
+	filter_max_silence_ms = max_silence_ms;
+	k_mutex_unlock(&filter_lock);
+}
+
+static bool channel_changed(const struct report_deadband *band,
+			    uint16_t last, uint16_t value)
+{
+	uint32_t diff = abs((int32_t)value - (int32_t)last);
+
+	if (band->abs == 0 && band->rel_permille == 0) {
+		return diff != 0;
+	}
+
+	if (band->abs != 0 && diff > band->abs) {
+		return true;
+	}
+
+	return band->rel_permille != 0 &&
+	       diff * 1000U > (uint32_t)band->rel_permille * last;
+}
+
+bool report_filter_check(const uint16_t *values, size_t num_values)
+{
+	int64_t elapsed;
+	bool changed = false;
+	bool report;
+
+	num_values = MIN(num_values, REPORT_FILTER_MAX_CHANNELS);
+
+	k_mutex_lock(&filter_lock, K_FOREVER);
+
+	elapsed = k_uptime_get() - last_report;
+	if (last_report == 0 || num_values != last_num_values) {
+		/* Nothing reported yet */
+		report = true;
+		goto out;
+	}
+
+	if (filter_max_silence_ms != 0 && elapsed >= filter_max_silence_ms) {
+		LOG_DBG("Heartbeat after %lld ms", elapsed);
+		report = true;
+		goto out;
+	}
+
+	for (size_t i = 0; i < num_values; i++) {
+		if (channel_changed(&deadband[i], last_values[i], values[i])) {
+			LOG_DBG("Channel %u left its deadband", i);
+			changed = true;
+			break;
+		}
+	}
+
+	report = changed && elapsed >= filter_min_interval_ms;
+
+out:
+	k_mutex_unlock(&filter_lock);
+
+	return report;
+}
+
+void report_filter_update(const uint16_t *values, size_t num_values)
+{
+	num_values = MIN(num_values, REPORT_FILTER_MAX_CHANNELS);
+
+	k_mutex_lock(&filter_lock, K_FOREVER);
+	memcpy(last_values, values, num_values * sizeof(values[0]));
+	last_num_values = num_values;
+	last_report = k_uptime_get();
+	k_mutex_unlock(&filter_lock);
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_deadband(const struct shell *sh, size_t argc, char **argv)
+{
+	unsigned long channel = strtoul(argv[1], NULL, 0);
+	unsigned long abs_band = strtoul(argv[2], NULL, 0);
+	unsigned long rel_band = argc > 3 ? strtoul(argv[3], NULL, 0) : 0;
+
+	if (abs_band > UINT16_MAX || rel_band > UINT16_MAX ||
+	    report_filter_set_deadband(channel, abs_band, rel_band)) {
+		shell_error(sh, "Invalid deadband");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int cmd_intervals(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(sh);
+	ARG_UNUSED(argc);
+
+	report_filter_set_intervals(strtoul(argv[1], NULL, 0),
+				    strtoul(argv[2], NULL, 0));
+
+	return 0;
+}
+
+static int cmd_show(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	k_mutex_lock(&filter_lock, K_FOREVER);
+	shell_print(sh, "min interval %u ms, max silence %u ms",
+		    filter_min_interval_ms, filter_max_silence_ms);
+	for (size_t i = 0; i < REPORT_FILTER_MAX_CHANNELS; i++) {
+		shell_print(sh, "ch%u: abs %u, rel %u permille, last 0x%04x", i,
+			    deadband[i].abs, deadband[i].rel_permille,
+			    last_values[i]);
+	}
+	k_mutex_unlock(&filter_lock);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(report_cmds,
+	SHELL_CMD_ARG(deadband, NULL,
+		      "Set deadband <channel> <abs> [rel permille]",
+		      cmd_deadband, 3, 1),
+	SHELL_CMD_ARG(intervals, NULL,
+		      "Set intervals <min interval ms> <max silence ms>",
+		      cmd_intervals, 3, 0),
+	SHELL_CMD(show, NULL, "Show filter settings", cmd_show),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(report, &report_cmds, "Report-by-exception filter",
+		   NULL);
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __REPORT_FILTER_H__
+#define __REPORT_FILTER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of channels followed by the filter */
+#define REPORT_FILTER_MAX_CHANNELS 16
+
+/** @brief Set the deadband of one channel.
+ *
+ * A channel changes when its value moves away from the last reported one
+ * by more than @p abs, or by more than @p rel_permille of the last
+ * reported value. A limit of zero is not checked. With both limits zero
+ * any change of the value counts.
+ *
+ * @param[in] channel      Channel index.
+ * @param[in] abs          Absolute deadband, in register units.
+ * @param[in] rel_permille Relative deadband, in 1/1000 of the value.
+ *
+ * @retval 0 on success, -EINVAL if the channel does not exist.
+ */
+int report_filter_set_deadband(size_t channel, uint16_t abs,
+			       uint16_t rel_permille);
+
+/** @brief Set the timing limits of the reports.
+ *
+ * @param[in] min_interval_ms Minimum time between two reports triggered
+ *                            by a change, 0 for none.
+ * @param[in] max_silence_ms  Time after which the values are reported
+ *                            even if unchanged, 0 for never.
+ */
+void report_filter_set_intervals(uint32_t min_interval_ms,
+				 uint32_t max_silence_ms);
+
+/** @brief Check whether a reading has to be reported.
+ *
+ * @param[in] values     One value per channel.
+ * @param[in] num_values Number of values.
+ *
+ * @retval true if the reading has to be sent.
+ */
+bool report_filter_check(const uint16_t *values, size_t num_values);
+
+/** @brief Record a reading as reported.
+ *
+ * The values become the reference of the deadbands and the silence
+ * interval restarts.
+ *
+ * @param[in] values     One value per channel.
+ * @param[in] num_values Number of values.
+ */
+void report_filter_update(const uint16_t *values, size_t num_values);
+
+#endif
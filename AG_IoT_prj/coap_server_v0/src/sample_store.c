@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include "sample_store.h"
+
+LOG_MODULE_REGISTER(sample_store, LOG_LEVEL_INF);
+
+#define RAM_SLOTS CONFIG_COAP_SERVER_STORE_SAMPLES
+
+static K_MUTEX_DEFINE(store_lock);
+
+/* Newest samples, the flash tier keeps the older ones */
+static struct sensor_sample ram_ring[RAM_SLOTS];
+static size_t ram_head;
+static size_t ram_count;
+
+static uint32_t dropped;
+
+#if defined(CONFIG_COAP_SERVER_STORE_SETTINGS)
+#define FLASH_SLOTS CONFIG_COAP_SERVER_STORE_SETTINGS_SAMPLES
+#define STORE_KEY "sstore"
+#define STORE_KEY_LEN sizeof(STORE_KEY "/meta")
+
+/* Ring of settings entries STORE_KEY/<slot>, described by STORE_KEY/meta */
+struct flash_meta {
+	uint16_t boot;
+	uint16_t head;
+	uint16_t count;
+};
+
+struct flash_record {
+	/* Boot the timestamp refers to */
+	uint16_t boot;
+	struct sensor_sample sample;
+};
+
+struct flash_load {
+	void *data;
+	size_t len;
+	bool found;
+};
+
+static struct flash_meta meta;
+
+static int flash_load_cb(const char *key, size_t len, settings_read_cb read_cb,
+			 void *cb_arg, void *param)
+{
+	struct flash_load *load = param;
+	ssize_t ret;
+
+	/* Only the entry itself, not the ones below it */
+	if (key != NULL) {
+		return 0;
+	}
+
+	if (len != load->len) {
+		return -EINVAL;
+	}
+
+	ret = read_cb(cb_arg, load->data, len);
+	if (ret < 0) {
+		return ret;
+	}
+
+	load->found = true;
+
+	return 0;
+}
+
+static int flash_load(const char *key, void *data, size_t len)
+{
+	struct flash_load load = {
+		.data = data,
+		.len = len,
+	};
+	int err;
+
+	err = settings_load_subtree_direct(key, flash_load_cb, &load);
+	if (err) {
+		return err;
+	}
+
+	return load.found ? 0 : -ENOENT;
+}
+
+static void flash_slot_key(char *key, size_t idx)
+{
+	snprintk(key, STORE_KEY_LEN, STORE_KEY "/%u",
+		 (unsigned int)((meta.head + idx) % FLASH_SLOTS));
+}
+
+static int flash_meta_save(void)
+{
+	return settings_save_one(STORE_KEY "/meta", &meta, sizeof(meta));
+}
+
+static int flash_init(void)
+{
+	int err;
+
+	err = settings_subsys_init();
+	if (err) {
+		return err;
+	}
+
+	err = flash_load(STORE_KEY "/meta", &meta, sizeof(meta));
+	if (err && err != -ENOENT) {
+		return err;
+	}
+
+	if (meta.count > 0) {
+		LOG_INF("%u samples left in flash", meta.count);
+	}
+
+	meta.boot++;
+
+	return flash_meta_save();
+}
+
+static size_t flash_count(void)
+{
+	return meta.count;
+}
+
+static void flash_put(const struct sensor_sample *sample)
+{
+	struct flash_record record = {
+		.boot = meta.boot,
+		.sample = *sample,
+	};
+	char key[STORE_KEY_LEN];
+	int err;
+
+	if (meta.count == FLASH_SLOTS) {
+		meta.head = (meta.head + 1) % FLASH_SLOTS;
+		meta.count--;
+		dropped++;
+	}
+
+	flash_slot_key(key, meta.count);
+	err = settings_save_one(key, &record, sizeof(record));
+	if (err) {
+		LOG_ERR("Failed to save sample (%d)", err);
+		dropped++;
+		return;
+	}
+
+	meta.count++;
+
+	err = flash_meta_save();
+	if (err) {
+		LOG_ERR("Failed to save store state (%d)", err);
+	}
+}
+
+static int flash_peek(size_t idx, struct sensor_sample *sample)
+{
+	struct flash_record record;
+	char key[STORE_KEY_LEN];
+	int err;
+
+	flash_slot_key(key, idx);
+	err = flash_load(key, &record, sizeof(record));
+	if (err) {
+		return err == -ENOENT ? -EIO : err;
+	}
+
+	*sample = record.sample;
+	if (record.boot != meta.boot) {
+		/* Uptime restarted since the sample was taken */
+		sample->timestamp = SAMPLE_TIME_UNKNOWN;
+	}
+
+	return 0;
+}
+
+static size_t flash_drop(size_t num)
+{
+	char key[STORE_KEY_LEN];
+
+	num = MIN(num, meta.count);
+	if (num == 0) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < num; i++) {
+		flash_slot_key(key, i);
+		settings_delete(key);
+	}
+
+	meta.head = (meta.head + num) % FLASH_SLOTS;
+	meta.count -= num;
+	flash_meta_save();
+
+	return num;
+}
+#else
+static int flash_init(void)
+{
+	return 0;
+}
+
+static size_t flash_count(void)
+{
+	return 0;
+}
+
+static void flash_put(const struct sensor_sample *sample)
+{
+	ARG_UNUSED(sample);
+
+	dropped++;
+}
+
+static int flash_peek(size_t idx, struct sensor_sample *sample)
+{
+	ARG_UNUSED(idx);
+	ARG_UNUSED(sample);
+
+	return -ENOENT;
+}
+
+static size_t flash_drop(size_t num)
+{
+	ARG_UNUSED(num);
+
+	return 0;
+}
+#endif
+
+int sample_store_init(void)
+{
+	int err;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+	err = flash_init();
+	k_mutex_unlock(&store_lock);
+
+	return err;
+}
+
+void sample_store_put(const struct sensor_sample *sample)
+{
+	uint32_t was_dropped;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	was_dropped = dropped;
+
+	if (ram_count == RAM_SLOTS) {
+		flash_put(&ram_ring[ram_head]);
+		ram_head = (ram_head + 1) % RAM_SLOTS;
+		ram_count--;
+	}
+
+	ram_ring[(ram_head + ram_count) % RAM_SLOTS] = *sample;
+	ram_count++;
+
+	if (dropped != was_dropped) {
+		LOG_WRN("Sample store full, %u samples dropped", dropped);
+	}
+
+	k_mutex_unlock(&store_lock);
+}
+
+size_t sample_store_count(void)
+{
+	size_t count;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+	count = flash_count() + ram_count;
+	k_mutex_unlock(&store_lock);
+
+	return count;
+}
+
+int sample_store_peek(size_t idx, struct sensor_sample *sample)
+{
+	int ret = 0;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	if (idx < flash_count()) {
+		ret = flash_peek(idx, sample);
+		goto out;
+	}
+
+	idx -= flash_count();
+	if (idx >= ram_count) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	*sample = ram_ring[(ram_head + idx) % RAM_SLOTS];
+
+out:
+	k_mutex_unlock(&store_lock);
+
+	return ret;
+}
+
+void sample_store_drop(size_t num)
+{
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	num -= flash_drop(num);
+	num = MIN(num, ram_count);
+	ram_head = (ram_head + num) % RAM_SLOTS;
+	ram_count -= num;
+
+	k_mutex_unlock(&store_lock);
+}
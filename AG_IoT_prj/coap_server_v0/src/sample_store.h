@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __SAMPLE_STORE_H__
+#define __SAMPLE_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <coap_server_client_interface.h>
+
+/** Timestamp of a sample taken before the last reset */
+#define SAMPLE_TIME_UNKNOWN (-1)
+
+/**@brief Sensor reading waiting for upload. */
+struct sensor_sample {
+	/** Uptime in ms of the reading, or SAMPLE_TIME_UNKNOWN */
+	int64_t timestamp;
+	uint8_t unit_id;
+	uint8_t num_values;
+	uint16_t values[SENSOR_PAYLOAD_MAX_VALUES];
+};
+
+/** @brief Initialize the sample store.
+ *
+ * Samples left in flash by a previous boot are kept for upload.
+ *
+ * @retval 0 on success, negative error code otherwise.
+ */
+int sample_store_init(void);
+
+/** @brief Store a sample.
+ *
+ * Once the RAM ring is full its oldest sample moves to the flash tier if
+ * enabled, or is dropped otherwise. A full flash tier drops its oldest
+ * sample.
+ *
+ * @param[in] sample Sample to store.
+ */
+void sample_store_put(const struct sensor_sample *sample);
+
+/** @brief Get the number of stored samples.
+ */
+size_t sample_store_count(void);
+
+/** @brief Copy a stored sample, from the oldest one.
+ *
+ * @param[in]  idx    Index of the sample, 0 for the oldest one.
+ * @param[out] sample Sample copy.
+ *
+ * @retval 0 on success, -ENOENT if there is no such sample, other
+ *         negative error code if the sample could not be read.
+ */
+int sample_store_peek(size_t idx, struct sensor_sample *sample);
+
+/** @brief Remove the oldest samples, once they have been uploaded.
+ *
+ * @param[in] num Number of samples to remove.
+ */
+void sample_store_drop(size_t num);
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/openthread.h>
+#include <openthread/coap.h>
+#include <openthread/ip6.h>
+#include <openthread/message.h>
+#include <coap_server_client_interface.h>
+
+#include "coap_con.h"
+#include "modbus_poll.h"
+#include "poll_control.h"
+#include "sensor_resource.h"
+
+LOG_MODULE_REGISTER(sensor_resource, LOG_LEVEL_INF);
+
+/* The Observe option value is a 24-bit sequence number (RFC 7641) */
+#define OBSERVE_SEQ_MASK 0xFFFFFF
+
+#define OBSERVE_REGISTER 0
+#define OBSERVE_DEREGISTER 1
+
+struct sensor_observer {
+	otMessageInfo info;
+	uint8_t token[OT_COAP_MAX_TOKEN_LENGTH];
+	uint8_t token_len;
+	bool active;
+	/* A confirmable notification still holds an OpenThread exchange */
+	bool con_pending;
+};
+
+/* Accessed with the OpenThread API mutex held only */
+static struct sensor_observer observers[CONFIG_COAP_SERVER_SENSOR_OBSERVERS];
+static uint32_t observe_seq;
+
+static uint8_t last_payload[SENSOR_PAYLOAD_MAX_LEN];
+static int last_len;
+static int64_t last_notify;
+
+static uint8_t sensor_unit_id;
+static size_t sensor_num_values;
+
+static struct k_work notify_work;
+
+static otCoapResource sensor_resource = {
+	.mUriPath = SENSOR_URI_PATH,
+	.mHandler = NULL,
+	.mContext = NULL,
+	.mNext = NULL,
+};
+
+static int sensor_payload_get(uint8_t *payload, size_t size)
+{
+	uint16_t values[SENSOR_PAYLOAD_MAX_VALUES];
+	int num;
+
+	num = modbus_poll_read(sensor_unit_id, values, sensor_num_values,
+			       NULL);
+	if (num < 0) {
+		return num;
+	}
+
+	return sensor_payload_encode(payload, size, sensor_unit_id, values,
+				     num);
+}
+
+static bool observer_match(const struct sensor_observer *observer,
+			   const otMessageInfo *info)
+{
+	return observer->active &&
+	       observer->info.mPeerPort == info->mPeerPort &&
+	       otIp6IsAddressEqual(&observer->info.mPeerAddr,
+				   &info->mPeerAddr);
+}
+
+static struct sensor_observer *observer_find(const otMessageInfo *info)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(observers); i++) {
+		if (observer_match(&observers[i], info)) {
+			return &observers[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* One registration per endpoint, a new token replaces the previous one */
+static struct sensor_observer *observer_add(otMessage *request,
+					    const otMessageInfo *info)
+{
+	struct sensor_observer *observer = observer_find(info);
+
+	for (size_t i = 0; observer == NULL && i < ARRAY_SIZE(observers); i++) {
+		if (!observers[i].active) {
+			observer = &observers[i];
+		}
+	}
+
+	if (observer == NULL) {
+		return NULL;
+	}
+
+	observer->info = *info;
+	/* Let the stack select the source address, the request may be
+	 * addressed to a multicast group.
+	 */
+	memset(&observer->info.mSockAddr, 0, sizeof(observer->info.mSockAddr));
+	observer->token_len = otCoapMessageGetTokenLength(request);
+	memcpy(observer->token, otCoapMessageGetToken(request),
+	       observer->token_len);
+	observer->active = true;
+
+	return observer;
+}
+
+static void observer_remove(const otMessageInfo *info)
+{
+	struct sensor_observer *observer = observer_find(info);
+
+	if (observer != NULL) {
+		observer->active = false;
+	}
+}
+
+/* A confirmable notification answered with a reset ends the observation
+ * (RFC 7641, 4.5). An observer acknowledges with an empty ACK, after which
+ * OpenThread waits for a separate response until the exchange lifetime
+ * ends and reports a timeout, so timeouts do not tell a lost observer
+ * apart and are ignored.
+ */
+static void notify_response_handler(void *context, otMessage *message,
+				    const otMessageInfo *message_info,
+				    otError result)
+{
+	struct sensor_observer *observer = context;
+
+	ARG_UNUSED(message);
+	ARG_UNUSED(message_info);
+
+	observer->con_pending = false;
+
+	if (result == OT_ERROR_ABORT && observer->active) {
+		LOG_INF("Observer %u reset the notification",
+			observer - observers);
+		observer->active = false;
+	}
+}
+
+static otError sensor_message_send(otInstance *ot, otMessage *request,
+				   const otMessageInfo *info,
+				   const uint8_t *token, uint8_t token_len,
+				   bool observe, const uint8_t *payload,
+				   int len, struct sensor_observer *observer)
+{
+	/* One exchange per observer, the notifications in between are NON */
+	bool confirmable = observer != NULL && !observer->con_pending &&
+			   IS_ENABLED(CONFIG_COAP_SERVER_SENSOR_NOTIFY_CON);
+	otError error = OT_ERROR_NO_BUFS;
+	otMessage *message;
+	otCoapCode code;
+
+	message = otCoapNewMessage(ot, NULL);
+	if (message == NULL) {
+		goto end;
+	}
+
+	code = len < 0 ? OT_COAP_CODE_SERVICE_UNAVAILABLE : OT_COAP_CODE_CONTENT;
+
+	if (request != NULL &&
+	    otCoapMessageGetType(request) == OT_COAP_TYPE_CONFIRMABLE) {
+		error = otCoapMessageInitResponse(message, request,
+						  OT_COAP_TYPE_ACKNOWLEDGMENT,
+						  code);
+	} else {
+		otCoapMessageInit(message, confirmable ?
+				  OT_COAP_TYPE_CONFIRMABLE :
+				  OT_COAP_TYPE_NON_CONFIRMABLE, code);
+		error = otCoapMessageSetToken(message, token, token_len);
+	}
+
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	if (observe) {
+		error = otCoapMessageAppendObserveOption(message, observe_seq);
+		if (error != OT_ERROR_NONE) {
+			goto end;
+		}
+	}
+
+	if (len < 0) {
+		goto send;
+	}
+
+	error = otCoapMessageAppendContentFormatOption(
+		message, OT_COAP_OPTION_CONTENT_FORMAT_OCTET_STREAM);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otCoapMessageSetPayloadMarker(message);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+	error = otMessageAppend(message, payload, len);
+	if (error != OT_ERROR_NONE) {
+		goto end;
+	}
+
+send:
+	if (confirmable) {
+		error = otCoapSendRequestWithParameters(
+			ot, message, info, notify_response_handler, observer,
+			coap_con_tx_parameters());
+		observer->con_pending = error == OT_ERROR_NONE;
+	} else {
+		error = otCoapSendResponse(ot, message, info);
+	}
+
+end:
+	if (error != OT_ERROR_NONE && message != NULL) {
+		otMessageFree(message);
+	}
+
+	return error;
+}
+
+static void sensor_request_handler(void *context, otMessage *message,
+				   const otMessageInfo *message_info)
+{
+	struct sensor_observer *observer = NULL;
+	uint8_t payload[SENSOR_PAYLOAD_MAX_LEN];
+	otCoapOptionIterator iterator;
+	uint64_t observe = OBSERVE_DEREGISTER;
+	otError error;
+	int len;
+
+	if (otCoapMessageGetCode(message) != OT_COAP_CODE_GET) {
+		LOG_ERR("Sensor handler - Unexpected CoAP code");
+		return;
+	}
+
+	/* Observers tend to come back, answer them without delay */
+	poll_control_activity();
+
+	if (otCoapOptionIteratorInit(&iterator, message) == OT_ERROR_NONE &&
+	    otCoapOptionIteratorGetFirstOptionMatching(
+		    &iterator, OT_COAP_OPTION_OBSERVE) != NULL) {
+		otCoapOptionIteratorGetOptionUintValue(&iterator, &observe);
+	}
+
+	if (observe == OBSERVE_REGISTER) {
+		observer = observer_add(message, message_info);
+		if (observer == NULL) {
+			LOG_WRN("No room for another observer");
+		}
+	} else {
+		observer_remove(message_info);
+	}
+
+	len = sensor_payload_get(payload, sizeof(payload));
+
+	error = sensor_message_send(context, message, message_info,
+				    otCoapMessageGetToken(message),
+				    otCoapMessageGetTokenLength(message),
+				    observer != NULL, payload, len, NULL);
+	if (error != OT_ERROR_NONE) {
+		LOG_ERR("Failed to send sensor response: %d", error);
+	}
+}
+
+static bool observers_active(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(observers); i++) {
+		if (observers[i].active) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void sensor_notify(struct k_work *item)
+{
+	struct openthread_context *context = openthread_get_default_context();
+	uint8_t payload[SENSOR_PAYLOAD_MAX_LEN];
+	int64_t now = k_uptime_get();
+	otError error;
+	int len;
+
+	ARG_UNUSED(item);
+
+	len = sensor_payload_get(payload, sizeof(payload));
+	if (len < 0) {
+		return;
+	}
+
+	if (len == last_len && memcmp(payload, last_payload, len) == 0 &&
+	    now - last_notify < CONFIG_COAP_SERVER_SENSOR_NOTIFY_PERIOD_MS) {
+		return;
+	}
+
+	openthread_api_mutex_lock(context);
+
+	if (!observers_active()) {
+		openthread_api_mutex_unlock(context);
+		return;
+	}
+
+	observe_seq = (observe_seq + 1) & OBSERVE_SEQ_MASK;
+
+	for (size_t i = 0; i < ARRAY_SIZE(observers); i++) {
+		struct sensor_observer *observer = &observers[i];
+
+		if (!observer->active) {
+			continue;
+		}
+
+		error = sensor_message_send(context->instance, NULL,
+					    &observer->info, observer->token,
+					    observer->token_len, true,
+					    payload, len, observer);
+		if (error != OT_ERROR_NONE) {
+			LOG_ERR("Failed to notify observer %u: %d", i, error);
+		}
+	}
+
+	openthread_api_mutex_unlock(context);
+
+	memcpy(last_payload, payload, len);
+	last_len = len;
+	last_notify = now;
+}
+
+static void on_sensor_read(uint8_t unit_id)
+{
+	if (unit_id == sensor_unit_id) {
+		k_work_submit(&notify_work);
+	}
+}
+
+int sensor_resource_init(uint8_t unit_id, size_t num_values)
+{
+	otInstance *ot = openthread_get_default_instance();
+
+	if (ot == NULL) {
+		return -ENODEV;
+	}
+
+	if (num_values > SENSOR_PAYLOAD_MAX_VALUES) {
+		return -EINVAL;
+	}
+
+	sensor_unit_id = unit_id;
+	sensor_num_values = num_values;
+
+	k_work_init(&notify_work, sensor_notify);
+
+	sensor_resource.mContext = ot;
+	sensor_resource.mHandler = sensor_request_handler;
+	otCoapAddResource(ot, &sensor_resource);
+
+	modbus_poll_set_callback(on_sensor_read);
+
+	return 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __SENSOR_RESOURCE_H__
+#define __SENSOR_RESOURCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Add the observable sensor resource to the OpenThread CoAP server.
+ *
+ * A GET on SENSOR_URI_PATH returns the last values read from the sensor by
+ * the polling scheduler. A GET carrying the Observe option registers the
+ * requester, which is then notified of every new reading that differs from
+ * the last notification, and at least every
+ * CONFIG_COAP_SERVER_SENSOR_NOTIFY_PERIOD_MS otherwise.
+ *
+ * @param[in] unit_id    Unit ID of the polled sensor.
+ * @param[in] num_values Number of values read from the sensor.
+ *
+ * @retval 0 on success, negative error code otherwise.
+ */
+int sensor_resource_init(uint8_t unit_id, size_t num_values);
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/random/random.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/openthread.h>
+#include <net/coap_utils.h>
+#include <openthread/coap.h>
+#include <openthread/message.h>
+#include <openthread/thread.h>
+#include <coap_server_client_interface.h>
+
+#include "coap_con.h"
+#include "modbus_poll.h"
+#include "sync_sample.h"
+
+LOG_MODULE_REGISTER(sync_sample, LOG_LEVEL_INF);
+
+static const char *const snapshot_option[] = { SNAPSHOT_URI_PATH, NULL };
+
+/* Protects the last trigger */
+static K_MUTEX_DEFINE(trigger_lock);
+
+static struct {
+	struct sockaddr_in6 collector;
+	int64_t received;
+	uint32_t delay_ms;
+	uint16_t seq;
+	bool valid;
+} trigger;
+
+static uint8_t sample_unit_id;
+static size_t sample_num_values;
+
+static struct k_work_delayable reply_work;
+
+static otCoapResource sample_resource = {
+	.mUriPath = SAMPLE_URI_PATH,
+	.mHandler = NULL,
+	.mContext = NULL,
+	.mNext = NULL,
+};
+
+/* Spread the answers of all nodes over the window so they do not collide.
+ * Children come last, their answers take one more hop through the parent.
+ */
+static uint32_t reply_delay(otInstance *ot, uint16_t num_nodes)
+{
+	uint32_t window = MIN((uint32_t)MAX(num_nodes, 1) *
+			      CONFIG_COAP_SERVER_SYNC_SLOT_MS,
+			      CONFIG_COAP_SERVER_SYNC_WINDOW_MAX_MS);
+	uint32_t half = window / 2;
+
+	switch (otThreadGetDeviceRole(ot)) {
+	case OT_DEVICE_ROLE_ROUTER:
+	case OT_DEVICE_ROLE_LEADER:
+		return sys_rand32_get() % MAX(half, 1);
+	default:
+		return half + sys_rand32_get() % MAX(window - half, 1);
+	}
+}
+
+static void snapshot_send(struct k_work *item)
+{
+	uint16_t values[SENSOR_PAYLOAD_MAX_VALUES];
+	uint8_t payload[SENSOR_SNAPSHOT_MAX_LEN];
+	struct sockaddr_in6 collector;
+	uint16_t seq;
+	int len;
+	int err;
+
+	ARG_UNUSED(item);
+
+	k_mutex_lock(&trigger_lock, K_FOREVER);
+	collector = trigger.collector;
+	seq = trigger.seq;
+	k_mutex_unlock(&trigger_lock);
+
+	len = modbus_poll_read(sample_unit_id, values, sample_num_values, NULL);
+	if (len < 0) {
+		return;
+	}
+
+	len = sensor_snapshot_encode(payload, sizeof(payload), seq,
+				     sample_unit_id, values, len);
+	if (len < 0) {
+		return;
+	}
+
+	LOG_INF("Send snapshot %u", seq);
+
+	if (IS_ENABLED(CONFIG_COAP_SERVER_LIGHT_CON)) {
+		err = coap_con_put(&collector, SNAPSHOT_URI_PATH, payload, len,
+				   NULL);
+	} else {
+		err = coap_send_request(COAP_METHOD_PUT,
+					(const struct sockaddr *)&collector,
+					snapshot_option, payload, len, NULL);
+	}
+
+	if (err < 0) {
+		LOG_ERR("Failed to send snapshot %u (%d)", seq, err);
+	}
+}
+
+static void on_sampled(uint8_t unit_id)
+{
+	int64_t due;
+
+	ARG_UNUSED(unit_id);
+
+	k_mutex_lock(&trigger_lock, K_FOREVER);
+	due = trigger.received + trigger.delay_ms;
+	k_mutex_unlock(&trigger_lock);
+
+	k_work_reschedule(&reply_work,
+			  K_MSEC(MAX(due - k_uptime_get(), 0)));
+}
+
+static void sample_request_handler(void *context, otMessage *message,
+				   const otMessageInfo *message_info)
+{
+	uint8_t payload[SAMPLE_TRIGGER_LEN];
+	uint16_t num_nodes;
+	uint16_t seq;
+	uint16_t len;
+	int err;
+
+	if (otCoapMessageGetCode(message) != OT_COAP_CODE_PUT ||
+	    otCoapMessageGetType(message) != OT_COAP_TYPE_NON_CONFIRMABLE) {
+		LOG_ERR("Sample handler - Unexpected CoAP message");
+		return;
+	}
+
+	len = otMessageRead(message, otMessageGetOffset(message), payload,
+			    sizeof(payload));
+	if (otMessageGetLength(message) - otMessageGetOffset(message) != len) {
+		LOG_ERR("Sample handler - Payload too long");
+		return;
+	}
+
+	err = sample_trigger_decode(payload, len, &seq, &num_nodes);
+	if (err) {
+		LOG_ERR("Sample handler - Invalid trigger (%d)", err);
+		return;
+	}
+
+	k_mutex_lock(&trigger_lock, K_FOREVER);
+
+	/* Multicast forwarding can deliver the trigger more than once */
+	if (trigger.valid && trigger.seq == seq) {
+		k_mutex_unlock(&trigger_lock);
+		return;
+	}
+
+	memset(&trigger.collector, 0, sizeof(trigger.collector));
+	trigger.collector.sin6_family = AF_INET6;
+	trigger.collector.sin6_port = htons(COAP_PORT);
+	memcpy(&trigger.collector.sin6_addr, &message_info->mPeerAddr,
+	       sizeof(trigger.collector.sin6_addr));
+	trigger.received = k_uptime_get();
+	trigger.delay_ms = reply_delay(context, num_nodes);
+	trigger.seq = seq;
+	trigger.valid = true;
+
+	LOG_INF("Snapshot %u of %u nodes, answer in %u ms", seq, num_nodes,
+		trigger.delay_ms);
+
+	k_mutex_unlock(&trigger_lock);
+
+	err = modbus_poll_trigger(sample_unit_id, on_sampled);
+	if (err) {
+		LOG_ERR("Cannot sample unit %u (%d)", sample_unit_id, err);
+	}
+}
+
+int sync_sample_init(uint8_t unit_id, size_t num_values)
+{
+	otInstance *ot = openthread_get_default_instance();
+
+	if (ot == NULL) {
+		return -ENODEV;
+	}
+
+	if (num_values > SENSOR_PAYLOAD_MAX_VALUES) {
+		return -EINVAL;
+	}
+
+	sample_unit_id = unit_id;
+	sample_num_values = num_values;
+
+	k_work_init_delayable(&reply_work, snapshot_send);
+
+	sample_resource.mContext = ot;
+	sample_resource.mHandler = sample_request_handler;
+	otCoapAddResource(ot, &sample_resource);
+
+	return 0;
+}
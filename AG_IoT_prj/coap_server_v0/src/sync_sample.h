@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __SYNC_SAMPLE_H__
+#define __SYNC_SAMPLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Add the synchronized sampling resource to the OpenThread CoAP
+ *         server.
+ *
+ * A PUT on SAMPLE_URI_PATH, usually multicast by the collector to every
+ * node of the mesh, reads the sensor at once. The reading is sent back to
+ * the collector on SNAPSHOT_URI_PATH after a random delay within a window
+ * of CONFIG_COAP_SERVER_SYNC_SLOT_MS per node. Routers answer in the first
+ * half of the window, children in the second half, once their parent is
+ * done with its own answer.
+ *
+ * @param[in] unit_id    Unit ID of the polled sensor.
+ * @param[in] num_values Number of values read from the sensor.
+ *
+ * @retval 0 on success, negative error code otherwise.
+ */
+int sync_sample_init(uint8_t unit_id, size_t num_values);
+
+#endif
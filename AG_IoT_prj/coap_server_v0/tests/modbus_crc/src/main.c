@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/crc.h>
+
+#define CRC16_POLY 0xA001
+#define CRC16_INIT 0xFFFF
+#define FRAME_SIZE 256
+#define BENCH_ROUNDS 1000
+
+/* modbus_crc.c built with CONFIG_MODBUS_CRC_TABLE and _SLICE_BY_4 */
+uint16_t modbus_crc16_table(uint16_t crc, const uint8_t *src, size_t len);
+uint16_t modbus_crc16_slice_by_4(uint16_t crc, const uint8_t *src,
+				 size_t len);
+
+typedef uint16_t (*crc16_fn_t)(uint16_t crc, const uint8_t *src, size_t len);
+
+static const struct crc16_impl {
+	const char *name;
+	crc16_fn_t fn;
+} impls[] = {
+	{ "table", modbus_crc16_table },
+	{ "slice-by-4", modbus_crc16_slice_by_4 },
+};
+
+/* Room for a frame at any alignment */
+static uint8_t frame[FRAME_SIZE + 3];
+
+static void frame_fill(void *fixture)
+{
+	uint32_t x = 0x12345678;
+
+	ARG_UNUSED(fixture);
+
+	for (size_t i = 0; i < sizeof(frame); i++) {
+		x = x * 1103515245 + 12345;
+		frame[i] = x >> 16;
+	}
+}
+
+static uint16_t crc16_ref(uint16_t crc, const uint8_t *src, size_t len)
+{
+	return crc16_reflect(CRC16_POLY, crc, src, len);
+}
+
+ZTEST(modbus_crc, test_known_frame)
+{
+	/* Read 10 holding registers of unit 1, CRC sent as C5 CD */
+	static const uint8_t req[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x0A };
+
+	zassert_equal(crc16_ref(CRC16_INIT, req, sizeof(req)), 0xCDC5);
+
+	for (size_t i = 0; i < ARRAY_SIZE(impls); i++) {
+		zassert_equal(impls[i].fn(CRC16_INIT, req, sizeof(req)),
+			      0xCDC5, "%s", impls[i].name);
+	}
+}
+
+ZTEST(modbus_crc, test_reference)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(impls); i++) {
+		for (size_t offset = 0; offset < 4; offset++) {
+			for (size_t len = 0; len <= FRAME_SIZE; len++) {
+				const uint8_t *src = &frame[offset];
+
+				zassert_equal(impls[i].fn(CRC16_INIT, src, len),
+					      crc16_ref(CRC16_INIT, src, len),
+					      "%s, offset %zu, length %zu",
+					      impls[i].name, offset, len);
+			}
+		}
+	}
+}
+
+/* The CRC is updated character by character while a frame is received */
+ZTEST(modbus_crc, test_streaming)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(impls); i++) {
+		uint16_t crc = CRC16_INIT;
+
+		for (size_t pos = 0; pos < FRAME_SIZE; pos++) {
+			crc = impls[i].fn(crc, &frame[pos], 1);
+		}
+
+		zassert_equal(crc, crc16_ref(CRC16_INIT, frame, FRAME_SIZE),
+			      "%s", impls[i].name);
+
+		/* A frame followed by its CRC checks to zero */
+		crc = impls[i].fn(CRC16_INIT, frame, FRAME_SIZE - 2);
+		frame[FRAME_SIZE - 2] = crc & 0xFF;
+		frame[FRAME_SIZE - 1] = crc >> 8;
+		zassert_equal(impls[i].fn(CRC16_INIT, frame, FRAME_SIZE), 0,
+			      "%s", impls[i].name);
+	}
+}
+
+static uint32_t bench(crc16_fn_t fn)
+{
+	volatile uint16_t crc;
+	uint32_t start;
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < BENCH_ROUNDS; i++) {
+		crc = fn(CRC16_INIT, frame, FRAME_SIZE);
+	}
+	(void)crc;
+
+	return (k_cycle_get_32() - start) / BENCH_ROUNDS;
+}
+
+ZTEST(modbus_crc, test_benchmark)
+{
+	TC_PRINT("%s: %u cycles per %d byte frame\n", "bitwise",
+		 bench(crc16_ref), FRAME_SIZE);
+
+	for (size_t i = 0; i < ARRAY_SIZE(impls); i++) {
+		TC_PRINT("%s: %u cycles per %d byte frame\n", impls[i].name,
+			 bench(impls[i].fn), FRAME_SIZE);
+	}
+}
+
+ZTEST_SUITE(modbus_crc, NULL, NULL, frame_fill, NULL, NULL);
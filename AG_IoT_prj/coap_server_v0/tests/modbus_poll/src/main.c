@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/ztest.h>
+#include <modbus_ext.h>
+
+#include "modbus_poll.h"
+
+static int suspend_calls;
+static int resume_calls;
+static int resume_err;
+static bool suspended;
+
+int modbus_iface_suspend(const int iface)
+{
+	ARG_UNUSED(iface);
+
+	suspend_calls++;
+	if (suspended) {
+		return -EALREADY;
+	}
+
+	suspended = true;
+
+	return 0;
+}
+
+int modbus_iface_resume(const int iface)
+{
+	ARG_UNUSED(iface);
+
+	resume_calls++;
+	if (resume_err) {
+		return resume_err;
+	}
+
+	if (!suspended) {
+		return -EALREADY;
+	}
+
+	suspended = false;
+
+	return 0;
+}
+
+/* Scans are not run, the planner is linked in with the polling table */
+int modbus_read_holding_regs(const int iface, const uint8_t unit_id,
+			     const uint16_t start_addr, uint16_t *const reg_buf,
+			     const uint16_t num_regs)
+{
+	return -ENOTSUP;
+}
+
+static void reset(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	suspend_calls = 0;
+	resume_calls = 0;
+	resume_err = 0;
+	suspended = true;
+}
+
+ZTEST(modbus_poll, test_session)
+{
+	struct modbus_poll_power_stats before;
+	struct modbus_poll_power_stats after;
+
+	modbus_poll_power_stats_get(&before);
+
+	zassert_ok(modbus_poll_session_begin());
+	zassert_equal(resume_calls, 1);
+	zassert_false(suspended);
+
+	modbus_poll_session_end();
+	zassert_equal(suspend_calls, 1);
+	zassert_true(suspended);
+
+	modbus_poll_power_stats_get(&after);
+	zassert_equal(after.sessions, before.sessions + 1);
+	zassert_true(after.awake_ms - before.awake_ms >=
+		     CONFIG_COAP_SERVER_SENSOR_WARMUP_MS);
+}
+
+ZTEST(modbus_poll, test_nesting)
+{
+	struct modbus_poll_power_stats before;
+	struct modbus_poll_power_stats after;
+
+	modbus_poll_power_stats_get(&before);
+
+	zassert_ok(modbus_poll_session_begin());
+	zassert_ok(modbus_poll_session_begin());
+	zassert_ok(modbus_poll_session_begin());
+	zassert_equal(resume_calls, 1);
+
+	/* The line stays powered until the outermost session ends */
+	modbus_poll_session_end();
+	modbus_poll_session_end();
+	zassert_equal(suspend_calls, 0);
+	zassert_false(suspended);
+
+	modbus_poll_session_end();
+	zassert_equal(suspend_calls, 1);
+	zassert_true(suspended);
+
+	modbus_poll_power_stats_get(&after);
+	zassert_equal(after.sessions, before.sessions + 1);
+}
+
+ZTEST(modbus_poll, test_unbalanced_end)
+{
+	modbus_poll_session_end();
+	zassert_equal(suspend_calls, 0);
+
+	zassert_ok(modbus_poll_session_begin());
+	modbus_poll_session_end();
+	modbus_poll_session_end();
+	zassert_equal(resume_calls, 1);
+	zassert_equal(suspend_calls, 1);
+}
+
+ZTEST(modbus_poll, test_resume_failure)
+{
+	struct modbus_poll_power_stats before;
+	struct modbus_poll_power_stats after;
+
+	modbus_poll_power_stats_get(&before);
+
+	resume_err = -EIO;
+	zassert_equal(modbus_poll_session_begin(), -EIO);
+	zassert_true(suspended);
+
+	/* A failed session is not counted and leaves nothing to end */
+	modbus_poll_power_stats_get(&after);
+	zassert_equal(after.sessions, before.sessions);
+
+	resume_err = 0;
+	zassert_ok(modbus_poll_session_begin());
+	zassert_equal(resume_calls, 2);
+	modbus_poll_session_end();
+	zassert_equal(suspend_calls, 1);
+}
+
+ZTEST(modbus_poll, test_already_resumed)
+{
+	/* The line was left powered, e.g. by modbus_poll_start() failing */
+	suspended = false;
+
+	zassert_ok(modbus_poll_session_begin());
+	zassert_equal(resume_calls, 1);
+	modbus_poll_session_end();
+	zassert_equal(suspend_calls, 1);
+	zassert_true(suspended);
+}
+
+ZTEST_SUITE(modbus_poll, NULL, NULL, reset, NULL, NULL);
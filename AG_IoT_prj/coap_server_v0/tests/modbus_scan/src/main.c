@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/modbus/modbus.h>
+
+#include "modbus_scan.h"
+
+/* Registers of the soil sensor, listed out of order */
+static const struct modbus_scan_slot soil_slots[] = {
+	{ "temperature", 0x07 },
+	{ "ec",          0x08 },
+	{ "nitrogen",    0x1E },
+	{ "humidity",    0x06 },
+	{ "potassium",   0x20 },
+	{ "ph",          0x09 },
+	{ "phosphorus",  0x1F },
+};
+
+static int fc03_calls;
+
+static bool reg_implemented(uint16_t addr)
+{
+	return (addr >= 0x06 && addr <= 0x09) || (addr >= 0x1E && addr <= 0x20);
+}
+
+static uint16_t reg_value(uint16_t addr)
+{
+	return addr ^ 0xA500;
+}
+
+/* Server implementing only the soil sensor registers */
+int modbus_read_holding_regs(const int iface, const uint8_t unit_id,
+			     const uint16_t start_addr, uint16_t *const reg_buf,
+			     const uint16_t num_regs)
+{
+	fc03_calls++;
+
+	for (uint16_t i = 0; i < num_regs; i++) {
+		if (!reg_implemented(start_addr + i)) {
+			return MODBUS_EXC_ILLEGAL_DATA_ADDR;
+		}
+
+		reg_buf[i] = reg_value(start_addr + i);
+	}
+
+	return 0;
+}
+
+static void check_values(const uint16_t *values)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(soil_slots); i++) {
+		zassert_equal(values[i], reg_value(soil_slots[i].addr),
+			      "wrong value of %s", soil_slots[i].name);
+	}
+}
+
+static void reset(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	fc03_calls = 0;
+}
+
+ZTEST(modbus_scan, test_gap_merge)
+{
+	struct modbus_scan_plan plan;
+
+	zassert_ok(modbus_scan_plan_build(&plan, soil_slots,
+					  ARRAY_SIZE(soil_slots), 4));
+	zassert_equal(plan.num_blocks, 2);
+	zassert_equal(plan.blocks[0].start_addr, 0x06);
+	zassert_equal(plan.blocks[0].num_regs, 4);
+	zassert_equal(plan.blocks[1].start_addr, 0x1E);
+	zassert_equal(plan.blocks[1].num_regs, 3);
+
+	/* A gap of 20 unused registers is bridged once allowed */
+	zassert_ok(modbus_scan_plan_build(&plan, soil_slots,
+					  ARRAY_SIZE(soil_slots), 20));
+	zassert_equal(plan.num_blocks, 1);
+	zassert_equal(plan.blocks[0].start_addr, 0x06);
+	zassert_equal(plan.blocks[0].num_regs, 0x20 - 0x06 + 1);
+}
+
+ZTEST(modbus_scan, test_no_gap)
+{
+	static const struct modbus_scan_slot slots[] = {
+		{ "a", 4 }, { "b", 1 }, { "c", 2 }, { "d", 2 },
+	};
+	struct modbus_scan_plan plan;
+
+	/* Adjacent registers merge, duplicates are read once */
+	zassert_ok(modbus_scan_plan_build(&plan, slots, ARRAY_SIZE(slots), 0));
+	zassert_equal(plan.num_blocks, 2);
+	zassert_equal(plan.blocks[0].start_addr, 1);
+	zassert_equal(plan.blocks[0].num_regs, 2);
+	zassert_equal(plan.blocks[1].start_addr, 4);
+	zassert_equal(plan.blocks[1].num_regs, 1);
+}
+
+ZTEST(modbus_scan, test_max_regs)
+{
+	static const struct modbus_scan_slot slots[] = {
+		{ "a", 0 }, { "b", 124 }, { "c", 125 }, { "d", 300 },
+	};
+	struct modbus_scan_plan plan;
+
+	zassert_equal(MODBUS_SCAN_MAX_REGS, 125);
+	zassert_ok(modbus_scan_plan_build(&plan, slots, ARRAY_SIZE(slots),
+					  124));
+	zassert_equal(plan.num_blocks, 3);
+	zassert_equal(plan.blocks[0].start_addr, 0);
+	zassert_equal(plan.blocks[0].num_regs, 125);
+	zassert_equal(plan.blocks[1].start_addr, 125);
+	zassert_equal(plan.blocks[1].num_regs, 1);
+	zassert_equal(plan.blocks[2].start_addr, 300);
+	zassert_equal(plan.blocks[2].num_regs, 1);
+}
+
+ZTEST(modbus_scan, test_invalid)
+{
+	static struct modbus_scan_slot slots[MODBUS_SCAN_MAX_SLOTS + 1];
+	struct modbus_scan_plan plan;
+
+	zassert_equal(modbus_scan_plan_build(&plan, slots, 0, 4), -EINVAL);
+	zassert_equal(modbus_scan_plan_build(&plan, slots, ARRAY_SIZE(slots),
+					     4), -EINVAL);
+}
+
+ZTEST(modbus_scan, test_run)
+{
+	uint16_t values[ARRAY_SIZE(soil_slots)];
+	struct modbus_scan_plan plan;
+
+	zassert_ok(modbus_scan_plan_build(&plan, soil_slots,
+					  ARRAY_SIZE(soil_slots), 4));
+	zassert_ok(modbus_scan_plan_run(&plan, 0, 1, values));
+	zassert_equal(fc03_calls, 2);
+	check_values(values);
+}
+
+ZTEST(modbus_scan, test_run_fallback)
+{
+	uint16_t values[ARRAY_SIZE(soil_slots)];
+	struct modbus_scan_plan plan;
+
+	/* The merged block spans registers the server rejects */
+	zassert_ok(modbus_scan_plan_build(&plan, soil_slots,
+					  ARRAY_SIZE(soil_slots), 20));
+	zassert_ok(modbus_scan_plan_run(&plan, 0, 1, values));
+	zassert_equal(fc03_calls, 1 + ARRAY_SIZE(soil_slots));
+	check_values(values);
+}
+
+ZTEST_SUITE(modbus_scan, NULL, NULL, reset, NULL, NULL);
@@ -153,6 +153,16 @@ static int mbc_validate_rd_response(struct modbus_context *ctx,
 		// }
 		break;
 
+	case MODBUS_FC23_HOLDING_REGS_RD_WR:
+		if (req_qty * sizeof(uint16_t) != resp_byte_cnt) {
+			LOG_ERR("Mismatch in the number of registers");
+			err = -EINVAL;
+		} else {
+			modbus_regs_get_be(data_p16, resp_data, req_qty);
+			err = 0;
+		}
+		break;
+
 	default:
 		LOG_ERR("Validation not implemented for FC 0x%02x", fc);
 		err = -ENOTSUP;
@@ -248,20 +258,265 @@ static int mbc_validate_wr_response(struct modbus_context *ctx,
 	return err;
 }
 
-static int mbc_send_cmd(struct modbus_context *ctx, const uint8_t unit_id,
-			uint8_t fc, void *data)
+/* Record groups of a file record transaction */
+static const struct modbus_file_record *mbc_txn_file_records(
+	const struct modbus_txn *txn)
+{
+	return txn->fc == MODBUS_FC21_FILE_WR ? txn->wr_data : txn->data;
+}
+
+static int mbc_validate_fc20_response(struct modbus_context *ctx,
+				      struct modbus_file_record *recs,
+				      uint8_t num_recs)
+{
+	size_t resp_byte_cnt = ctx->rx_adu.data[0];
+	uint8_t *resp_data = &ctx->rx_adu.data[1];
+	size_t offset = 0;
+
+	if ((resp_byte_cnt + 1) != ctx->rx_adu.length) {
+		LOG_ERR("Byte count does not match the response length");
+		return -EINVAL;
+	}
+
+	for (uint8_t i = 0; i < num_recs; i++) {
+		size_t grp_len = 1 + recs[i].num * sizeof(uint16_t);
+
+		if ((offset + 1 + grp_len) > resp_byte_cnt ||
+		    resp_data[offset] != grp_len ||
+		    resp_data[offset + 1] != MODBUS_FILE_REF_TYPE) {
+			LOG_ERR("Mismatch in record group %u", i);
+			return -EINVAL;
+		}
+
+		modbus_regs_get_be(recs[i].regs, &resp_data[offset + 2],
+				   recs[i].num);
+		offset += 1 + grp_len;
+	}
+
+	if (offset != resp_byte_cnt) {
+		LOG_ERR("Mismatch in the number of record groups");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int mbc_validate_fc21_response(struct modbus_context *ctx)
+{
+	if (ctx->rx_adu.length != ctx->tx_adu.length ||
+	    memcmp(ctx->rx_adu.data, ctx->tx_adu.data, ctx->tx_adu.length)) {
+		LOG_ERR("Response is not an echo of the request");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int mbc_validate_fc43_response(struct modbus_context *ctx,
+				      struct modbus_device_id_chunk *chunk)
+{
+	uint8_t *resp_data = ctx->rx_adu.data;
+	uint16_t length = ctx->rx_adu.length;
+	uint16_t offset = MODBUS_FC43_RSP_HDR_LEN;
+
+	if (length < MODBUS_FC43_RSP_HDR_LEN ||
+	    resp_data[0] != MODBUS_FC43_MEI_DEVICE_ID ||
+	    resp_data[1] != ctx->tx_adu.data[1]) {
+		LOG_ERR("Mismatch in MEI type or read device ID code");
+		return -EINVAL;
+	}
+
+	for (uint8_t i = 0; i < resp_data[5]; i++) {
+		if ((offset + 2) > length ||
+		    (offset + 2 + resp_data[offset + 1]) > length) {
+			LOG_ERR("Object %u exceeds the response", i);
+			return -EINVAL;
+		}
+
+		offset += 2 + resp_data[offset + 1];
+	}
+
+	if (offset != length) {
+		LOG_ERR("Mismatch in the number of objects");
+		return -EINVAL;
+	}
+
+	if ((offset - MODBUS_FC43_RSP_HDR_LEN) > chunk->size) {
+		LOG_ERR("Length of data buffer is not sufficient");
+		return -ENOBUFS;
+	}
+
+	memcpy(chunk->buf, &resp_data[MODBUS_FC43_RSP_HDR_LEN],
+	       offset - MODBUS_FC43_RSP_HDR_LEN);
+	chunk->len = offset - MODBUS_FC43_RSP_HDR_LEN;
+	chunk->num_objects = resp_data[5];
+	chunk->conformity = resp_data[2];
+	chunk->more = resp_data[3] == MODBUS_FC43_MORE_FOLLOWS;
+	chunk->next_id = resp_data[4];
+
+	return 0;
+}
+
+/* Length of the request payload without unit ID and function code */
+static size_t mbc_txn_req_length(const struct modbus_txn *txn)
+{
+	size_t num_bytes;
+
+	switch (txn->fc) {
+	case MODBUS_FC15_COILS_WR:
+		num_bytes = (uint8_t)(((txn->num - 1) / 8) + 1);
+		break;
+	case MODBUS_FC16_HOLDING_REGS_WR:
+		if (txn->flags & MODBUS_TXN_FLAG_FP) {
+			num_bytes = txn->num * sizeof(float);
+		} else {
+			num_bytes = txn->num * sizeof(uint16_t);
+		}
+		break;
+	case MODBUS_FC20_FILE_RD:
+		/* Byte count and record groups */
+		return 1 + txn->num * MODBUS_FILE_GROUP_HDR_LEN;
+	case MODBUS_FC21_FILE_WR:
+		/* Byte count and record groups with their values */
+		num_bytes = 1;
+		for (uint16_t i = 0; i < txn->num; i++) {
+			num_bytes += MODBUS_FILE_GROUP_HDR_LEN +
+				     mbc_txn_file_records(txn)[i].num *
+				     sizeof(uint16_t);
+		}
+		return num_bytes;
+	case MODBUS_FC23_HOLDING_REGS_RD_WR:
+		/* Read and write address and quantity, byte count, values */
+		return 9 + txn->wr_num * sizeof(uint16_t);
+	case MODBUS_FC43_ENCAP_IF:
+		/* MEI type, read device ID code and object ID */
+		return 3;
+	default:
+		return 4;
+	}
+
+	/* Starting address, quantity, byte count and values */
+	return 5 + num_bytes;
+}
+
+static void mbc_file_records_encode(const struct modbus_txn *txn,
+				    struct modbus_adu *adu)
+{
+	const struct modbus_file_record *recs = mbc_txn_file_records(txn);
+	uint8_t *data_ptr = &adu->data[1];
+
+	adu->data[0] = adu->length - 1;
+
+	for (uint16_t i = 0; i < txn->num; i++) {
+		*data_ptr++ = MODBUS_FILE_REF_TYPE;
+		sys_put_be16(recs[i].file, &data_ptr[0]);
+		sys_put_be16(recs[i].record, &data_ptr[2]);
+		sys_put_be16(recs[i].num, &data_ptr[4]);
+		data_ptr += MODBUS_FILE_GROUP_HDR_LEN - 1;
+
+		if (txn->fc == MODBUS_FC21_FILE_WR) {
+			modbus_regs_put_be(data_ptr, recs[i].regs, recs[i].num);
+			data_ptr += recs[i].num * sizeof(uint16_t);
+		}
+	}
+}
+
+void modbus_client_txn_encode(struct modbus_txn *txn, struct modbus_adu *adu)
+{
+	uint8_t *data_ptr;
+	size_t length;
+
+	if (txn->flags & MODBUS_TXN_FLAG_RAW) {
+		memcpy(adu, txn->data, sizeof(struct modbus_adu));
+		return;
+	}
+
+	length = mbc_txn_req_length(txn);
+
+	adu->unit_id = txn->unit_id;
+	adu->fc = txn->fc;
+	adu->length = length;
+
+	switch (txn->fc) {
+	case MODBUS_FC20_FILE_RD:
+	case MODBUS_FC21_FILE_WR:
+		mbc_file_records_encode(txn, adu);
+		return;
+
+	case MODBUS_FC43_ENCAP_IF:
+		adu->data[0] = MODBUS_FC43_MEI_DEVICE_ID;
+		adu->data[1] = (uint8_t)txn->addr;
+		adu->data[2] = (uint8_t)txn->num;
+		return;
+
+	default:
+		break;
+	}
+
+	sys_put_be16(txn->addr, &adu->data[0]);
+	sys_put_be16(txn->num, &adu->data[2]);
+	data_ptr = &adu->data[5];
+
+	switch (txn->fc) {
+	case MODBUS_FC15_COILS_WR:
+		adu->data[4] = length - 5;
+		memcpy(data_ptr, txn->data, length - 5);
+		break;
+
+	case MODBUS_FC16_HOLDING_REGS_WR:
+		adu->data[4] = length - 5;
+
+		for (uint16_t i = 0; i < txn->num; i++) {
+			if (txn->flags & MODBUS_TXN_FLAG_FP) {
+				uint32_t reg_val;
+
+				memcpy(&reg_val, &((float *)txn->data)[i],
+				       sizeof(reg_val));
+				sys_put_be32(reg_val, data_ptr);
+				data_ptr += sizeof(uint32_t);
+			} else {
+				sys_put_be16(((uint16_t *)txn->data)[i],
+					     data_ptr);
+				data_ptr += sizeof(uint16_t);
+			}
+		}
+		break;
+
+	case MODBUS_FC23_HOLDING_REGS_RD_WR:
+		sys_put_be16(txn->wr_addr, &adu->data[4]);
+		sys_put_be16(txn->wr_num, &adu->data[6]);
+		adu->data[8] = length - 9;
+		modbus_regs_put_be(&adu->data[9], txn->wr_data, txn->wr_num);
+		break;
+
+	default:
+		break;
+	}
+}
+
+int modbus_client_txn_decode(struct modbus_context *ctx,
+			     struct modbus_txn *txn)
 {
+	uint8_t fc = txn->fc;
 	int err;
 
-	ctx->tx_adu.unit_id = unit_id;
-	ctx->tx_adu.fc = fc;
+	if (txn->flags & MODBUS_TXN_FLAG_RAW) {
+		/*
+		 * Serial line does not use transaction and protocol IDs.
+		 * Keep transaction and protocol IDs of the request.
+		 */
+		struct modbus_adu *adu = txn->data;
+		uint16_t trans_id = adu->trans_id;
+		uint16_t proto_id = adu->proto_id;
 
-	err = modbus_tx_wait_rx_adu(ctx);
-	if (err != 0) {
-		return err;
+		memcpy(adu, &ctx->rx_adu, sizeof(struct modbus_adu));
+		adu->trans_id = trans_id;
+		adu->proto_id = proto_id;
+
+		return 0;
 	}
 
-	err = mbc_validate_response_fc(ctx, unit_id, fc);
+	err = mbc_validate_response_fc(ctx, txn->unit_id, fc);
 	if (err < 0) {
 		LOG_ERR("Failed to validate unit ID or function code");
 		return err;
@@ -275,18 +530,31 @@ static int mbc_send_cmd(struct modbus_context *ctx, const uint8_t unit_id,
 	case MODBUS_FC02_DI_RD:
 	case MODBUS_FC03_HOLDING_REG_RD:
 	case MODBUS_FC04_IN_REG_RD:
-		err = mbc_validate_rd_response(ctx, unit_id, fc, data);
+	case MODBUS_FC23_HOLDING_REGS_RD_WR:
+		err = mbc_validate_rd_response(ctx, txn->unit_id, fc, txn->data);
 		break;
 
 	case MODBUS_FC08_DIAGNOSTICS:
-		err = mbc_validate_fc08_response(ctx, unit_id, data);
+		err = mbc_validate_fc08_response(ctx, txn->unit_id, txn->data);
 		break;
 
 	case MODBUS_FC05_COIL_WR:
 	case MODBUS_FC06_HOLDING_REG_WR:
 	case MODBUS_FC15_COILS_WR:
 	case MODBUS_FC16_HOLDING_REGS_WR:
-		err = mbc_validate_wr_response(ctx, unit_id, fc);
+		err = mbc_validate_wr_response(ctx, txn->unit_id, fc);
+		break;
+
+	case MODBUS_FC20_FILE_RD:
+		err = mbc_validate_fc20_response(ctx, txn->data, txn->num);
+		break;
+
+	case MODBUS_FC21_FILE_WR:
+		err = mbc_validate_fc21_response(ctx);
+		break;
+
+	case MODBUS_FC43_ENCAP_IF:
+		err = mbc_validate_fc43_response(ctx, txn->data);
 		break;
 
 	default:
@@ -297,29 +565,315 @@ static int mbc_send_cmd(struct modbus_context *ctx, const uint8_t unit_id,
 	return err;
 }
 
+static void mbc_txn_init(struct modbus_txn *txn, const uint8_t unit_id,
+			 uint8_t fc, uint16_t addr, uint16_t num, void *data)
+{
+	txn->unit_id = unit_id;
+	txn->fc = fc;
+	txn->addr = addr;
+	txn->num = num;
+	txn->data = data;
+	txn->flags = 0;
+}
+
+#ifdef CONFIG_MODBUS_CLIENT_HEALTH
+/* Length of the expected RTU response, 0 if unknown */
+static uint32_t mbc_txn_rsp_length(const struct modbus_txn *txn)
+{
+	if (txn->flags & MODBUS_TXN_FLAG_RAW) {
+		return 0;
+	}
+
+	switch (txn->fc) {
+	case MODBUS_FC01_COIL_RD:
+	case MODBUS_FC02_DI_RD:
+		return 5 + ((txn->num + 7) / 8);
+	case MODBUS_FC03_HOLDING_REG_RD:
+	case MODBUS_FC04_IN_REG_RD:
+		if (txn->flags & MODBUS_TXN_FLAG_FP) {
+			return 5 + txn->num * sizeof(float);
+		}
+
+		return 5 + txn->num * sizeof(uint16_t);
+	case MODBUS_FC23_HOLDING_REGS_RD_WR:
+		return 5 + txn->num * sizeof(uint16_t);
+	case MODBUS_FC20_FILE_RD: {
+		const struct modbus_file_record *recs = txn->data;
+		uint32_t length = 5;
+
+		for (uint16_t i = 0; i < txn->num; i++) {
+			length += 2 + recs[i].num * sizeof(uint16_t);
+		}
+
+		return length;
+	}
+	case MODBUS_FC21_FILE_WR:
+		/* Echo of the request */
+		return 4 + mbc_txn_req_length(txn);
+	case MODBUS_FC05_COIL_WR:
+	case MODBUS_FC06_HOLDING_REG_WR:
+	case MODBUS_FC08_DIAGNOSTICS:
+	case MODBUS_FC15_COILS_WR:
+	case MODBUS_FC16_HOLDING_REGS_WR:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Time the request and response of the active transaction occupy the bus,
+ * including the inter-frame delay detecting the end of the response.
+ */
+static uint32_t mbc_bus_time(struct modbus_context *ctx, uint32_t rsp_len)
+{
+	uint32_t num_bytes = ctx->tx_adu.length + 4 + rsp_len;
+
+	switch (ctx->mode) {
+	case MODBUS_MODE_RTU:
+		return num_bytes * ctx->cfg->char_time + ctx->cfg->rtu_timeout;
+	case MODBUS_MODE_ASCII:
+		/* Two characters per byte, framing instead of CRC */
+		return (2 * num_bytes + 2) * ctx->cfg->char_time;
+	default:
+		return 0;
+	}
+}
+
+static struct modbus_unit_health *mbc_health_get(struct modbus_context *ctx,
+						 uint8_t unit_id, bool add)
+{
+	struct modbus_unit_health *health;
+
+	for (size_t i = 0; i < ARRAY_SIZE(ctx->health); i++) {
+		if (ctx->health[i].unit_id == unit_id) {
+			return &ctx->health[i];
+		}
+	}
+
+	if (!add) {
+		return NULL;
+	}
+
+	/* Reuse entries round robin, but keep the units that are down */
+	for (size_t i = 0; i < ARRAY_SIZE(ctx->health); i++) {
+		health = &ctx->health[ctx->health_next];
+		ctx->health_next = (ctx->health_next + 1) % ARRAY_SIZE(ctx->health);
+
+		if (!health->down && !health->probe_pending) {
+			memset(health, 0, sizeof(*health));
+			health->unit_id = unit_id;
+			return health;
+		}
+	}
+
+	return NULL;
+}
+
+static void mbc_health_probe_done(const int iface, struct modbus_txn *txn,
+				  int err)
+{
+	struct modbus_unit_health *health;
+
+	health = CONTAINER_OF(txn, struct modbus_unit_health, probe);
+	health->probe_pending = false;
+}
+
+/* Send a diagnostic query to every unit that is down. */
+static void mbc_health_probe_handler(struct k_work *item)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(item);
+	struct modbus_unit_health *health;
+	struct modbus_context *ctx;
+	bool any_down = false;
+
+	ctx = CONTAINER_OF(dwork, struct modbus_context, health_probe_work);
+
+	for (size_t i = 0; i < ARRAY_SIZE(ctx->health); i++) {
+		health = &ctx->health[i];
+
+		if (!health->down) {
+			continue;
+		}
+
+		any_down = true;
+		if (health->probe_pending) {
+			continue;
+		}
+
+		/* Any answer, even an exception, shows the unit is alive */
+		mbc_txn_init(&health->probe, health->unit_id,
+			     MODBUS_FC08_DIAGNOSTICS, MODBUS_FC08_SUBF_QUERY,
+			     0, &health->probe_data);
+		health->probe.flags = MODBUS_TXN_FLAG_PROBE;
+		health->probe.cb = mbc_health_probe_done;
+		health->probe.signal = NULL;
+
+		if (modbus_txn_submit(ctx, &health->probe) == 0) {
+			health->probe_pending = true;
+		}
+	}
+
+	if (any_down) {
+		modbus_work_schedule(dwork,
+			K_MSEC(CONFIG_MODBUS_CLIENT_HEALTH_PROBE_INTERVAL));
+	}
+}
+
+void modbus_client_health_init(struct modbus_context *ctx)
+{
+	memset(ctx->health, 0, sizeof(ctx->health));
+	ctx->health_next = 0;
+	k_work_init_delayable(&ctx->health_probe_work,
+			      mbc_health_probe_handler);
+}
+
+int modbus_client_health_admit(struct modbus_context *ctx,
+			       struct modbus_txn *txn, uint32_t *timeout)
+{
+	struct modbus_unit_health *health;
+	uint32_t rsp_len = mbc_txn_rsp_length(txn);
+	uint32_t latency;
+
+	health = mbc_health_get(ctx, ctx->tx_adu.unit_id, false);
+	if (health == NULL) {
+		return 0;
+	}
+
+	if (health->down && !(txn->flags & MODBUS_TXN_FLAG_PROBE)) {
+		return -EHOSTDOWN;
+	}
+
+	if (health->samples == 0 || rsp_len == 0) {
+		return 0;
+	}
+
+	latency = MAX(health->srtt + 4 * health->rttvar,
+		      CONFIG_MODBUS_CLIENT_HEALTH_MIN_LATENCY);
+	*timeout = MIN(*timeout, mbc_bus_time(ctx, rsp_len) + latency);
+
+	return 0;
+}
+
+void modbus_client_health_update(struct modbus_context *ctx,
+				 struct modbus_txn *txn, int err)
+{
+	struct modbus_unit_health *health;
+	uint8_t unit_id = ctx->tx_adu.unit_id;
+	uint32_t rsp_len = mbc_txn_rsp_length(txn);
+	uint32_t elapsed;
+	uint32_t bus_time;
+	uint32_t sample;
+	uint32_t delta;
+
+	if (unit_id == 0) {
+		/* Broadcast is not answered */
+		return;
+	}
+
+	health = mbc_health_get(ctx, unit_id, true);
+	if (health == NULL) {
+		return;
+	}
+
+	if (err == -ETIMEDOUT) {
+		if (health->timeouts < UINT8_MAX) {
+			health->timeouts++;
+		}
+
+		if (!health->down &&
+		    health->timeouts >= CONFIG_MODBUS_CLIENT_HEALTH_DOWN_THRESHOLD) {
+			LOG_WRN("Unit %u does not respond, marked down", unit_id);
+			health->down = true;
+			modbus_work_schedule(&ctx->health_probe_work,
+				K_MSEC(CONFIG_MODBUS_CLIENT_HEALTH_PROBE_INTERVAL));
+		}
+
+		return;
+	}
+
+	if (err < 0) {
+		/* Corrupted or invalid response, no latency sample */
+		return;
+	}
+
+	if (health->down) {
+		LOG_INF("Unit %u responds again", unit_id);
+		health->down = false;
+	}
+
+	health->timeouts = 0;
+
+	if (rsp_len == 0) {
+		return;
+	}
+
+	elapsed = k_cyc_to_us_floor32(k_cycle_get_32() - ctx->txn_start_cyc);
+	bus_time = mbc_bus_time(ctx, rsp_len);
+	sample = elapsed > bus_time ? elapsed - bus_time : 0;
+
+	/* Smoothed latency and deviation as used for TCP RTO (RFC 6298) */
+	if (health->samples == 0) {
+		health->srtt = sample;
+		health->rttvar = sample / 2;
+	} else {
+		delta = health->srtt > sample ? health->srtt - sample :
+						sample - health->srtt;
+		health->rttvar = (3 * health->rttvar + delta) / 4;
+		health->srtt = (7 * health->srtt + sample) / 8;
+	}
+
+	if (health->samples < UINT8_MAX) {
+		health->samples++;
+	}
+}
+#endif /* CONFIG_MODBUS_CLIENT_HEALTH */
+
+static int mbc_txn_queue(const int iface, struct modbus_txn *txn, bool wait)
+{
+	struct modbus_context *ctx = modbus_get_context(iface);
+
+	if (ctx == NULL || !ctx->client) {
+		return -ENODEV;
+	}
+
+	if (mbc_txn_req_length(txn) > sizeof(ctx->tx_adu.data)) {
+		LOG_ERR("Length of data buffer is not sufficient");
+		return -ENOBUFS;
+	}
+
+	if (wait) {
+		return modbus_txn_submit_wait(ctx, txn);
+	}
+
+	return modbus_txn_submit(ctx, txn);
+}
+
 int modbus_read_coils(const int iface,
 		      const uint8_t unit_id,
 		      const uint16_t start_addr,
 		      uint8_t *const coil_tbl,
 		      const uint16_t num_coils)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
+	struct modbus_txn txn;
 
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
-
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC01_COIL_RD,
+		     start_addr, num_coils, coil_tbl);
 
-	ctx->tx_adu.length = 4;
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	sys_put_be16(num_coils, &ctx->tx_adu.data[2]);
+	return mbc_txn_queue(iface, &txn, true);
+}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC01_COIL_RD, coil_tbl);
-	k_mutex_unlock(&ctx->iface_lock);
+int modbus_submit_read_coils(const int iface,
+			     const uint8_t unit_id,
+			     const uint16_t start_addr,
+			     uint8_t *const coil_tbl,
+			     const uint16_t num_coils,
+			     struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC01_COIL_RD,
+		     start_addr, num_coils, coil_tbl);
 
-	return err;
+	return mbc_txn_queue(iface, txn, false);
 }
 
 int modbus_read_dinputs(const int iface,
@@ -328,23 +882,25 @@ int modbus_read_dinputs(const int iface,
 			uint8_t *const di_tbl,
 			const uint16_t num_di)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
+	struct modbus_txn txn;
 
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
+	mbc_txn_init(&txn, unit_id, MODBUS_FC02_DI_RD,
+		     start_addr, num_di, di_tbl);
 
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
-
-	ctx->tx_adu.length = 4;
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	sys_put_be16(num_di, &ctx->tx_adu.data[2]);
+	return mbc_txn_queue(iface, &txn, true);
+}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC02_DI_RD, di_tbl);
-	k_mutex_unlock(&ctx->iface_lock);
+int modbus_submit_read_dinputs(const int iface,
+			       const uint8_t unit_id,
+			       const uint16_t start_addr,
+			       uint8_t *const di_tbl,
+			       const uint16_t num_di,
+			       struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC02_DI_RD,
+		     start_addr, num_di, di_tbl);
 
-	return err;
+	return mbc_txn_queue(iface, txn, false);
 }
 
 int modbus_read_holding_regs(const int iface,
@@ -353,26 +909,27 @@ int modbus_read_holding_regs(const int iface,
 			     uint16_t *const reg_buf,
 			     const uint16_t num_regs)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
+	struct modbus_txn txn;
 
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
-
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC03_HOLDING_REG_RD,
+		     start_addr, num_regs, reg_buf);
 
-	ctx->tx_adu.length = 4;
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	sys_put_be16(num_regs, &ctx->tx_adu.data[2]);
+	return mbc_txn_queue(iface, &txn, true);
+}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC03_HOLDING_REG_RD, reg_buf);
-	k_mutex_unlock(&ctx->iface_lock);
+int modbus_submit_read_holding_regs(const int iface,
+				    const uint8_t unit_id,
+				    const uint16_t start_addr,
+				    uint16_t *const reg_buf,
+				    const uint16_t num_regs,
+				    struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC03_HOLDING_REG_RD,
+		     start_addr, num_regs, reg_buf);
 
-	return err;
+	return mbc_txn_queue(iface, txn, false);
 }
 
-
 #ifdef CONFIG_MODBUS_FP_EXTENSIONS
 int modbus_read_holding_regs_fp(const int iface,
 			       const uint8_t unit_id,
@@ -380,23 +937,13 @@ int modbus_read_holding_regs_fp(const int iface,
 			       float *const reg_buf,
 			       const uint16_t num_regs)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
+	struct modbus_txn txn;
 
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
-
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
-
-	ctx->tx_adu.length = 4;
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	sys_put_be16(num_regs, &ctx->tx_adu.data[2]);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC03_HOLDING_REG_RD,
+		     start_addr, num_regs, reg_buf);
+	txn.flags = MODBUS_TXN_FLAG_FP;
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC03_HOLDING_REG_RD, reg_buf);
-	k_mutex_unlock(&ctx->iface_lock);
-
-	return err;
+	return mbc_txn_queue(iface, &txn, true);
 }
 #endif
 
@@ -406,23 +953,34 @@ int modbus_read_input_regs(const int iface,
 			   uint16_t *const reg_buf,
 			   const uint16_t num_regs)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
+	struct modbus_txn txn;
 
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
+	mbc_txn_init(&txn, unit_id, MODBUS_FC04_IN_REG_RD,
+		     start_addr, num_regs, reg_buf);
 
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	return mbc_txn_queue(iface, &txn, true);
+}
 
-	ctx->tx_adu.length = 4;
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	sys_put_be16(num_regs, &ctx->tx_adu.data[2]);
+int modbus_submit_read_input_regs(const int iface,
+				  const uint8_t unit_id,
+				  const uint16_t start_addr,
+				  uint16_t *const reg_buf,
+				  const uint16_t num_regs,
+				  struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC04_IN_REG_RD,
+		     start_addr, num_regs, reg_buf);
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC04_IN_REG_RD, reg_buf);
-	k_mutex_unlock(&ctx->iface_lock);
+	return mbc_txn_queue(iface, txn, false);
+}
 
-	return err;
+static uint16_t mbc_coil_val(const bool coil_state)
+{
+	if (coil_state == false) {
+		return MODBUS_COIL_OFF_CODE;
+	}
+
+	return MODBUS_COIL_ON_CODE;
 }
 
 int modbus_write_coil(const int iface,
@@ -430,30 +988,24 @@ int modbus_write_coil(const int iface,
 		      const uint16_t coil_addr,
 		      const bool coil_state)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
-	uint16_t coil_val;
+	struct modbus_txn txn;
 
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
-
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC05_COIL_WR,
+		     coil_addr, mbc_coil_val(coil_state), NULL);
 
-	if (coil_state == false) {
-		coil_val = MODBUS_COIL_OFF_CODE;
-	} else {
-		coil_val = MODBUS_COIL_ON_CODE;
-	}
-
-	ctx->tx_adu.length = 4;
-	sys_put_be16(coil_addr, &ctx->tx_adu.data[0]);
-	sys_put_be16(coil_val, &ctx->tx_adu.data[2]);
+	return mbc_txn_queue(iface, &txn, true);
+}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC05_COIL_WR, NULL);
-	k_mutex_unlock(&ctx->iface_lock);
+int modbus_submit_write_coil(const int iface,
+			     const uint8_t unit_id,
+			     const uint16_t coil_addr,
+			     const bool coil_state,
+			     struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC05_COIL_WR,
+		     coil_addr, mbc_coil_val(coil_state), NULL);
 
-	return err;
+	return mbc_txn_queue(iface, txn, false);
 }
 
 int modbus_write_holding_reg(const int iface,
@@ -461,23 +1013,24 @@ int modbus_write_holding_reg(const int iface,
 			     const uint16_t start_addr,
 			     const uint16_t reg_val)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
-
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
+	struct modbus_txn txn;
 
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC06_HOLDING_REG_WR,
+		     start_addr, reg_val, NULL);
 
-	ctx->tx_adu.length = 4;
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	sys_put_be16(reg_val, &ctx->tx_adu.data[2]);
+	return mbc_txn_queue(iface, &txn, true);
+}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC06_HOLDING_REG_WR, NULL);
-	k_mutex_unlock(&ctx->iface_lock);
+int modbus_submit_write_holding_reg(const int iface,
+				    const uint8_t unit_id,
+				    const uint16_t start_addr,
+				    const uint16_t reg_val,
+				    struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC06_HOLDING_REG_WR,
+		     start_addr, reg_val, NULL);
 
-	return err;
+	return mbc_txn_queue(iface, txn, false);
 }
 
 int modbus_request_diagnostic(const int iface,
@@ -486,23 +1039,12 @@ int modbus_request_diagnostic(const int iface,
 			      const uint16_t data,
 			      uint16_t *const data_out)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	int err;
-
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
+	struct modbus_txn txn;
 
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC08_DIAGNOSTICS,
+		     sfunc, data, data_out);
 
-	ctx->tx_adu.length = 4;
-	sys_put_be16(sfunc, &ctx->tx_adu.data[0]);
-	sys_put_be16(data, &ctx->tx_adu.data[2]);
-
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC08_DIAGNOSTICS, data_out);
-	k_mutex_unlock(&ctx->iface_lock);
-
-	return err;
+	return mbc_txn_queue(iface, &txn, true);
 }
 
 int modbus_write_coils(const int iface,
@@ -511,139 +1053,268 @@ int modbus_write_coils(const int iface,
 		       uint8_t *const coil_tbl,
 		       const uint16_t num_coils)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	size_t length = 0;
-	uint8_t *data_ptr;
-	size_t num_bytes;
-	int err;
+	struct modbus_txn txn;
 
-	if (ctx == NULL) {
-		return -ENODEV;
-	}
+	mbc_txn_init(&txn, unit_id, MODBUS_FC15_COILS_WR,
+		     start_addr, num_coils, coil_tbl);
 
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	return mbc_txn_queue(iface, &txn, true);
+}
 
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	length += sizeof(start_addr);
-	sys_put_be16(num_coils, &ctx->tx_adu.data[2]);
-	length += sizeof(num_coils);
+int modbus_submit_write_coils(const int iface,
+			      const uint8_t unit_id,
+			      const uint16_t start_addr,
+			      uint8_t *const coil_tbl,
+			      const uint16_t num_coils,
+			      struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC15_COILS_WR,
+		     start_addr, num_coils, coil_tbl);
 
-	num_bytes = (uint8_t)(((num_coils - 1) / 8) + 1);
-	ctx->tx_adu.data[4] = num_bytes;
-	length += num_bytes + 1;
+	return mbc_txn_queue(iface, txn, false);
+}
 
-	if (length > sizeof(ctx->tx_adu.data)) {
-		LOG_ERR("Length of data buffer is not sufficient");
-		k_mutex_unlock(&ctx->iface_lock);
-		return -ENOBUFS;
+int modbus_write_holding_regs(const int iface,
+			      const uint8_t unit_id,
+			      const uint16_t start_addr,
+			      uint16_t *const reg_buf,
+			      const uint16_t num_regs)
+{
+	struct modbus_txn txn;
+
+	mbc_txn_init(&txn, unit_id, MODBUS_FC16_HOLDING_REGS_WR,
+		     start_addr, num_regs, reg_buf);
+
+	return mbc_txn_queue(iface, &txn, true);
+}
+
+int modbus_submit_write_holding_regs(const int iface,
+				     const uint8_t unit_id,
+				     const uint16_t start_addr,
+				     uint16_t *const reg_buf,
+				     const uint16_t num_regs,
+				     struct modbus_txn *txn)
+{
+	mbc_txn_init(txn, unit_id, MODBUS_FC16_HOLDING_REGS_WR,
+		     start_addr, num_regs, reg_buf);
+
+	return mbc_txn_queue(iface, txn, false);
+}
+
+#ifdef CONFIG_MODBUS_FP_EXTENSIONS
+int modbus_write_holding_regs_fp(const int iface,
+				 const uint8_t unit_id,
+				 const uint16_t start_addr,
+				 float *const reg_buf,
+				 const uint16_t num_regs)
+{
+	struct modbus_txn txn;
+
+	mbc_txn_init(&txn, unit_id, MODBUS_FC16_HOLDING_REGS_WR,
+		     start_addr, num_regs, reg_buf);
+	txn.flags = MODBUS_TXN_FLAG_FP;
+
+	return mbc_txn_queue(iface, &txn, true);
+}
+#endif
+
+static int mbc_txn_init_fc23(struct modbus_txn *txn, const uint8_t unit_id,
+			     uint16_t rd_addr, uint16_t *rd_buf,
+			     uint16_t rd_num, uint16_t wr_addr,
+			     const uint16_t *wr_buf, uint16_t wr_num)
+{
+	if (rd_num == 0 || rd_num > MODBUS_REGS_MAX ||
+	    wr_num == 0 || wr_num > MODBUS_FC23_WR_REGS_MAX) {
+		LOG_ERR("Number of registers limit exceeded");
+		return -EINVAL;
 	}
 
-	ctx->tx_adu.length = length;
-	data_ptr = &ctx->tx_adu.data[5];
+	mbc_txn_init(txn, unit_id, MODBUS_FC23_HOLDING_REGS_RD_WR,
+		     rd_addr, rd_num, rd_buf);
+	txn->wr_addr = wr_addr;
+	txn->wr_num = wr_num;
+	txn->wr_data = wr_buf;
 
-	memcpy(data_ptr, coil_tbl, num_bytes);
+	return 0;
+}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC15_COILS_WR, NULL);
-	k_mutex_unlock(&ctx->iface_lock);
+int modbus_read_write_holding_regs(const int iface,
+				   const uint8_t unit_id,
+				   const uint16_t rd_addr,
+				   uint16_t *const rd_buf,
+				   const uint16_t rd_num,
+				   const uint16_t wr_addr,
+				   const uint16_t *const wr_buf,
+				   const uint16_t wr_num)
+{
+	struct modbus_txn txn;
+	int err;
 
-	return err;
+	err = mbc_txn_init_fc23(&txn, unit_id, rd_addr, rd_buf, rd_num,
+				wr_addr, wr_buf, wr_num);
+	if (err != 0) {
+		return err;
+	}
+
+	return mbc_txn_queue(iface, &txn, true);
 }
 
-int modbus_write_holding_regs(const int iface,
-			      const uint8_t unit_id,
-			      const uint16_t start_addr,
-			      uint16_t *const reg_buf,
-			      const uint16_t num_regs)
+int modbus_submit_read_write_holding_regs(const int iface,
+					  const uint8_t unit_id,
+					  const uint16_t rd_addr,
+					  uint16_t *const rd_buf,
+					  const uint16_t rd_num,
+					  const uint16_t wr_addr,
+					  const uint16_t *const wr_buf,
+					  const uint16_t wr_num,
+					  struct modbus_txn *txn)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	size_t length = 0;
-	uint8_t *data_ptr;
-	size_t num_bytes;
 	int err;
 
-	if (ctx == NULL) {
-		return -ENODEV;
+	err = mbc_txn_init_fc23(txn, unit_id, rd_addr, rd_buf, rd_num,
+				wr_addr, wr_buf, wr_num);
+	if (err != 0) {
+		return err;
 	}
 
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	return mbc_txn_queue(iface, txn, false);
+}
 
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	length += sizeof(start_addr);
-	sys_put_be16(num_regs, &ctx->tx_adu.data[2]);
-	length += sizeof(num_regs);
+static int mbc_file_records_check(const struct modbus_file_record *recs,
+				  uint8_t num_recs)
+{
+	if (num_recs == 0) {
+		return -EINVAL;
+	}
 
-	num_bytes = num_regs * sizeof(uint16_t);
-	ctx->tx_adu.data[4] = num_bytes;
-	length += num_bytes + 1;
+	for (uint8_t i = 0; i < num_recs; i++) {
+		if (recs[i].num == 0 || recs[i].file == 0 ||
+		    ((uint32_t)recs[i].record + recs[i].num - 1) >
+		    MODBUS_FILE_RECORD_MAX) {
+			LOG_ERR("Invalid record group %u", i);
+			return -EINVAL;
+		}
+	}
 
-	if (length > sizeof(ctx->tx_adu.data)) {
-		LOG_ERR("Length of data buffer is not sufficient");
-		k_mutex_unlock(&ctx->iface_lock);
+	return 0;
+}
+
+/* Length of an FC20 response payload, limited by the ADU and the spec */
+#define MBC_FILE_RD_LEN_MAX	MIN(MODBUS_ADU_DATA_SIZE, MODBUS_FILE_RD_BYTES_MAX)
+
+int modbus_read_file_records(const int iface,
+			     const uint8_t unit_id,
+			     struct modbus_file_record *const recs,
+			     const uint8_t num_recs)
+{
+	struct modbus_txn txn;
+	size_t rsp_len = 1;
+	int err;
+
+	err = mbc_file_records_check(recs, num_recs);
+	if (err != 0) {
+		return err;
+	}
+
+	for (uint8_t i = 0; i < num_recs; i++) {
+		rsp_len += 2 + recs[i].num * sizeof(uint16_t);
+	}
+
+	if (rsp_len > MBC_FILE_RD_LEN_MAX) {
+		LOG_ERR("Response would exceed the byte count limit");
 		return -ENOBUFS;
 	}
 
-	ctx->tx_adu.length = length;
-	data_ptr = &ctx->tx_adu.data[5];
+	mbc_txn_init(&txn, unit_id, MODBUS_FC20_FILE_RD, 0, num_recs, recs);
+
+	return mbc_txn_queue(iface, &txn, true);
+}
+
+int modbus_write_file_records(const int iface,
+			      const uint8_t unit_id,
+			      const struct modbus_file_record *const recs,
+			      const uint8_t num_recs)
+{
+	struct modbus_txn txn;
+	int err;
 
-	for (uint16_t i = 0; i < num_regs; i++) {
-		sys_put_be16(reg_buf[i], data_ptr);
-		data_ptr += sizeof(uint16_t);
+	err = mbc_file_records_check(recs, num_recs);
+	if (err != 0) {
+		return err;
 	}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC16_HOLDING_REGS_WR, NULL);
-	k_mutex_unlock(&ctx->iface_lock);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC21_FILE_WR, 0, num_recs, NULL);
+	txn.wr_data = recs;
 
-	return err;
+	return mbc_txn_queue(iface, &txn, true);
 }
 
-#ifdef CONFIG_MODBUS_FP_EXTENSIONS
-int modbus_write_holding_regs_fp(const int iface,
-				 const uint8_t unit_id,
-				 const uint16_t start_addr,
-				 float *const reg_buf,
-				 const uint16_t num_regs)
+/* Registers of one record group that fit into a response or request */
+#define MBC_FILE_RD_REGS_MAX	((MBC_FILE_RD_LEN_MAX - 3) / sizeof(uint16_t))
+#define MBC_FILE_WR_REGS_MAX	((MODBUS_ADU_DATA_SIZE - 8) / sizeof(uint16_t))
+
+static int mbc_file_xfer(const int iface, const uint8_t unit_id,
+			 struct modbus_file_xfer *const xfer, bool write)
 {
-	struct modbus_context *ctx = modbus_get_context(iface);
-	size_t length = 0;
-	uint8_t *data_ptr;
-	size_t num_bytes;
+	const uint16_t regs_max = write ? MBC_FILE_WR_REGS_MAX :
+					  MBC_FILE_RD_REGS_MAX;
+	struct modbus_file_record rec;
 	int err;
 
-	if (ctx == NULL) {
-		return -ENODEV;
+	if (((uint32_t)xfer->record + xfer->num) > (MODBUS_FILE_RECORD_MAX + 1)) {
+		LOG_ERR("Transfer exceeds the file");
+		return -EINVAL;
 	}
 
-	k_mutex_lock(&ctx->iface_lock, K_FOREVER);
+	while (xfer->done < xfer->num) {
+		rec.file = xfer->file;
+		rec.record = xfer->record + xfer->done;
+		rec.num = MIN(xfer->num - xfer->done, regs_max);
+		rec.regs = &xfer->regs[xfer->done];
 
-	sys_put_be16(start_addr, &ctx->tx_adu.data[0]);
-	length += sizeof(start_addr);
-	sys_put_be16(num_regs, &ctx->tx_adu.data[2]);
-	length += sizeof(num_regs);
+		if (write) {
+			err = modbus_write_file_records(iface, unit_id, &rec, 1);
+		} else {
+			err = modbus_read_file_records(iface, unit_id, &rec, 1);
+		}
 
-	num_bytes = num_regs * sizeof(float);
-	ctx->tx_adu.data[4] = num_bytes;
-	length += num_bytes + 1;
+		if (err != 0) {
+			return err;
+		}
 
-	if (length > sizeof(ctx->tx_adu.data)) {
-		LOG_ERR("Length of data buffer is not sufficient");
-		k_mutex_unlock(&ctx->iface_lock);
-		return -ENOBUFS;
+		xfer->done += rec.num;
 	}
 
-	ctx->tx_adu.length = length;
-	data_ptr = &ctx->tx_adu.data[5];
+	return 0;
+}
 
-	for (uint16_t i = 0; i < num_regs; i++) {
-		uint32_t reg_val;
+int modbus_read_file(const int iface, const uint8_t unit_id,
+		     struct modbus_file_xfer *const xfer)
+{
+	return mbc_file_xfer(iface, unit_id, xfer, false);
+}
 
-		memcpy(&reg_val, &reg_buf[i], sizeof(reg_val));
-		sys_put_be32(reg_val, data_ptr);
-		data_ptr += sizeof(uint32_t);
+int modbus_write_file(const int iface, const uint8_t unit_id,
+		      struct modbus_file_xfer *const xfer)
+{
+	return mbc_file_xfer(iface, unit_id, xfer, true);
+}
+
+int modbus_read_device_id(const int iface,
+			  const uint8_t unit_id,
+			  const enum modbus_device_id_code code,
+			  const uint8_t object_id,
+			  struct modbus_device_id_chunk *const chunk)
+{
+	struct modbus_txn txn;
+
+	if (code < MODBUS_DEVICE_ID_BASIC || code > MODBUS_DEVICE_ID_SPECIFIC ||
+	    chunk == NULL || chunk->buf == NULL) {
+		return -EINVAL;
 	}
 
-	err = mbc_send_cmd(ctx, unit_id, MODBUS_FC16_HOLDING_REGS_WR, NULL);
-	k_mutex_unlock(&ctx->iface_lock);
+	mbc_txn_init(&txn, unit_id, MODBUS_FC43_ENCAP_IF, code, object_id,
+		     chunk);
 
-	return err;
+	return mbc_txn_queue(iface, &txn, true);
 }
-#endif
@@ -9,6 +9,7 @@
 LOG_MODULE_REGISTER(modbus, CONFIG_MODBUS_LOG_LEVEL);
 
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
 #include <string.h>
 #include <zephyr/sys/byteorder.h>
 #include <modbus_internal.h>
@@ -65,6 +66,37 @@ static struct modbus_context mb_ctx_tbl[] = {
 #endif
 };
 
+#ifdef CONFIG_MODBUS_WORKQ
+static K_THREAD_STACK_DEFINE(modbus_workq_stack, CONFIG_MODBUS_WORKQ_STACK_SIZE);
+static struct k_work_q modbus_workq;
+
+static int modbus_workq_init(void)
+{
+	const struct k_work_queue_config cfg = {
+		.name = "modbus_workq",
+	};
+
+	k_work_queue_start(&modbus_workq, modbus_workq_stack,
+			   K_THREAD_STACK_SIZEOF(modbus_workq_stack),
+			   CONFIG_MODBUS_WORKQ_PRIORITY, &cfg);
+
+	return 0;
+}
+
+SYS_INIT(modbus_workq_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+#endif
+
+struct k_work_q *modbus_work_queue(void)
+{
+#ifdef CONFIG_MODBUS_WORKQ
+	return &modbus_workq;
+#else
+	return &k_sys_work_q;
+#endif
+}
+
+static void modbus_txn_rx_done(struct modbus_context *ctx);
+
 static void modbus_rx_handler(struct k_work *item)
 {
 	struct modbus_context *ctx;
@@ -90,7 +122,7 @@ static void modbus_rx_handler(struct k_work *item)
 	}
 
 	if (ctx->client == true) {
-		k_sem_give(&ctx->client_wait_sem);
+		modbus_txn_rx_done(ctx);
 	} else if (IS_ENABLED(CONFIG_MODBUS_SERVER)) {
 		bool respond = modbus_server_handler(ctx);
 
@@ -135,18 +167,323 @@ void modbus_tx_adu(struct modbus_context *ctx)
 	}
 }
 
-int modbus_tx_wait_rx_adu(struct modbus_context *ctx)
+#ifdef CONFIG_MODBUS_CLIENT
+static void modbus_txn_notify(struct modbus_context *ctx,
+			      struct modbus_txn *txn, int err)
+{
+	txn->err = err;
+
+	if (txn->cb != NULL) {
+		txn->cb(modbus_iface_get_by_ctx(ctx), txn, err);
+	}
+
+#ifdef CONFIG_POLL
+	if (txn->signal != NULL) {
+		k_poll_signal_raise(txn->signal, err);
+	}
+#endif
+}
+
+/* Put the next queued client transaction on the bus if the bus is idle. */
+static void modbus_txn_start(struct modbus_context *ctx)
+{
+	struct modbus_txn_slot *slot;
+	struct modbus_txn *txn;
+	k_spinlock_key_t key;
+	uint32_t timeout;
+	uint32_t wait;
+	int err;
+
+	if (atomic_test_bit(&ctx->state, MODBUS_STATE_SUSPENDED)) {
+		/* Queued transactions are started on resume */
+		return;
+	}
+
+	while (ctx->txn_active == NULL) {
+		slot = &ctx->txn_slot[ctx->txn_head];
+
+		key = k_spin_lock(&ctx->txn_lock);
+		txn = slot->txn;
+		k_spin_unlock(&ctx->txn_lock, key);
+
+		if (txn == NULL) {
+			return;
+		}
+
+		memcpy(&ctx->tx_adu, &slot->adu, sizeof(ctx->tx_adu));
+		wait = k_cycle_get_32() - slot->submit_cyc;
+
+		key = k_spin_lock(&ctx->txn_lock);
+		slot->txn = NULL;
+		ctx->txn_head = (ctx->txn_head + 1) % MODBUS_TXN_QUEUE_DEPTH;
+		ctx->txn_depth--;
+		ctx->txn_stats.started++;
+		ctx->txn_stats.wait_total += wait;
+		ctx->txn_stats.wait_max = MAX(ctx->txn_stats.wait_max, wait);
+		k_spin_unlock(&ctx->txn_lock, key);
+
+		k_sem_give(&ctx->txn_free);
+
+		timeout = ctx->rxwait_to;
+		if (IS_ENABLED(CONFIG_MODBUS_CLIENT_HEALTH)) {
+			err = modbus_client_health_admit(ctx, txn, &timeout);
+			if (err != 0) {
+				/* Unit is down, fail without using the bus */
+				modbus_txn_notify(ctx, txn, err);
+				continue;
+			}
+		}
+
+		ctx->txn_active = txn;
+		ctx->txn_start_cyc = k_cycle_get_32();
+		modbus_tx_adu(ctx);
+		modbus_work_schedule(&ctx->txn_timeout_work, K_USEC(timeout));
+	}
+}
+
+/*
+ * Complete the transaction on the bus. The response is validated before
+ * the next transaction reuses the ADUs, the user is notified afterwards so
+ * that the bus does not idle while the callback runs.
+ */
+static void modbus_txn_finish(struct modbus_context *ctx, int err)
+{
+	struct modbus_txn *txn = ctx->txn_active;
+
+	if (err == 0) {
+		err = modbus_client_txn_decode(ctx, txn);
+	}
+
+	if (IS_ENABLED(CONFIG_MODBUS_CLIENT_HEALTH)) {
+		modbus_client_health_update(ctx, txn, err);
+	}
+
+	ctx->txn_active = NULL;
+	modbus_txn_start(ctx);
+	modbus_txn_notify(ctx, txn, err);
+}
+
+static void modbus_txn_rx_done(struct modbus_context *ctx)
+{
+	if (ctx->txn_active == NULL) {
+		LOG_WRN("Client received unexpected frame");
+		return;
+	}
+
+	k_work_cancel_delayable(&ctx->txn_timeout_work);
+	modbus_txn_finish(ctx, ctx->rx_adu_err);
+}
+
+static void modbus_txn_handler(struct k_work *item)
 {
-	modbus_tx_adu(ctx);
+	struct modbus_context *ctx;
+
+	ctx = CONTAINER_OF(item, struct modbus_context, txn_work);
+	modbus_txn_start(ctx);
+}
+
+static void modbus_txn_timeout_handler(struct k_work *item)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(item);
+	struct modbus_context *ctx;
+
+	ctx = CONTAINER_OF(dwork, struct modbus_context, txn_timeout_work);
 
-	if (k_sem_take(&ctx->client_wait_sem, K_USEC(ctx->rxwait_to)) != 0) {
+	if (ctx->txn_active != NULL) {
 		LOG_WRN("Client wait-for-RX timeout");
-		return -ETIMEDOUT;
+		modbus_txn_finish(ctx, -ETIMEDOUT);
 	}
+}
+
+static int modbus_txn_enqueue(struct modbus_context *ctx,
+			      struct modbus_txn *txn, k_timeout_t timeout)
+{
+	struct modbus_txn_slot *slot;
+	k_spinlock_key_t key;
+
+	if (k_sem_take(&ctx->txn_free, timeout) != 0) {
+		key = k_spin_lock(&ctx->txn_lock);
+		ctx->txn_stats.rejected++;
+		k_spin_unlock(&ctx->txn_lock, key);
+
+		return -EBUSY;
+	}
+
+	key = k_spin_lock(&ctx->txn_lock);
+	slot = &ctx->txn_slot[ctx->txn_tail];
+	ctx->txn_tail = (ctx->txn_tail + 1) % MODBUS_TXN_QUEUE_DEPTH;
+	k_spin_unlock(&ctx->txn_lock, key);
+
+	/*
+	 * The slot is reserved but not yet visible to the scheduler,
+	 * encode the request outside of the lock.
+	 */
+	modbus_client_txn_encode(txn, &slot->adu);
+	slot->submit_cyc = k_cycle_get_32();
 
-	return ctx->rx_adu_err;
+	key = k_spin_lock(&ctx->txn_lock);
+	slot->txn = txn;
+	ctx->txn_depth++;
+	ctx->txn_stats.depth_max = MAX(ctx->txn_stats.depth_max,
+				       ctx->txn_depth);
+	k_spin_unlock(&ctx->txn_lock, key);
+
+	modbus_work_submit(&ctx->txn_work);
+
+	return 0;
+}
+
+int modbus_txn_submit(struct modbus_context *ctx, struct modbus_txn *txn)
+{
+	return modbus_txn_enqueue(ctx, txn, K_NO_WAIT);
+}
+
+static void modbus_txn_wait_done(const int iface, struct modbus_txn *txn,
+				 int err)
+{
+	k_sem_give((struct k_sem *)txn->user_data);
+}
+
+int modbus_txn_submit_wait(struct modbus_context *ctx,
+			   struct modbus_txn *txn)
+{
+	struct k_sem done;
+	int err;
+
+	/* The response is processed by the work queue the caller would block */
+	if (k_current_get() == k_work_queue_thread_get(modbus_work_queue())) {
+		LOG_ERR("Blocking client request from Modbus work queue");
+		return -EDEADLK;
+	}
+
+	k_sem_init(&done, 0, 1);
+	txn->cb = modbus_txn_wait_done;
+	txn->signal = NULL;
+	txn->user_data = &done;
+
+	err = modbus_txn_enqueue(ctx, txn, K_FOREVER);
+	if (err != 0) {
+		return err;
+	}
+
+	k_sem_take(&done, K_FOREVER);
+
+	return txn->err;
 }
 
+static void modbus_txn_flush(struct modbus_context *ctx, int err)
+{
+	struct modbus_txn_slot *slot;
+	struct k_work_sync work_sync;
+	struct modbus_txn *txn;
+	k_spinlock_key_t key;
+
+	k_work_cancel_sync(&ctx->txn_work, &work_sync);
+	k_work_cancel_delayable_sync(&ctx->txn_timeout_work, &work_sync);
+#ifdef CONFIG_MODBUS_CLIENT_HEALTH
+	k_work_cancel_delayable_sync(&ctx->health_probe_work, &work_sync);
+#endif
+
+	if (ctx->txn_active != NULL) {
+		txn = ctx->txn_active;
+		ctx->txn_active = NULL;
+		modbus_txn_notify(ctx, txn, err);
+	}
+
+	do {
+		slot = &ctx->txn_slot[ctx->txn_head];
+
+		key = k_spin_lock(&ctx->txn_lock);
+		txn = slot->txn;
+		if (txn != NULL) {
+			slot->txn = NULL;
+			ctx->txn_head = (ctx->txn_head + 1) % MODBUS_TXN_QUEUE_DEPTH;
+			ctx->txn_depth--;
+		}
+		k_spin_unlock(&ctx->txn_lock, key);
+
+		if (txn != NULL) {
+			k_sem_give(&ctx->txn_free);
+			modbus_txn_notify(ctx, txn, err);
+		}
+	} while (txn != NULL);
+}
+
+int modbus_client_queue_stats(const int iface,
+			      struct modbus_queue_stats *stats)
+{
+	struct modbus_context *ctx;
+	k_spinlock_key_t key;
+
+	ctx = modbus_get_context(iface);
+	if (ctx == NULL || !ctx->client) {
+		return -ENODEV;
+	}
+
+	key = k_spin_lock(&ctx->txn_lock);
+	*stats = ctx->txn_stats;
+	stats->depth = ctx->txn_depth;
+	k_spin_unlock(&ctx->txn_lock, key);
+
+	stats->wait_total = k_cyc_to_us_floor64(stats->wait_total);
+	stats->wait_max = k_cyc_to_us_floor32(stats->wait_max);
+
+	return 0;
+}
+
+static void modbus_txn_queue_init(struct modbus_context *ctx)
+{
+	k_sem_init(&ctx->txn_free, MODBUS_TXN_QUEUE_DEPTH,
+		   MODBUS_TXN_QUEUE_DEPTH);
+	ctx->txn_head = 0;
+	ctx->txn_tail = 0;
+	ctx->txn_depth = 0;
+	ctx->txn_active = NULL;
+	memset(&ctx->txn_stats, 0, sizeof(ctx->txn_stats));
+	k_work_init(&ctx->txn_work, modbus_txn_handler);
+	k_work_init_delayable(&ctx->txn_timeout_work,
+			      modbus_txn_timeout_handler);
+}
+#else
+static void modbus_txn_start(struct modbus_context *ctx)
+{
+	ARG_UNUSED(ctx);
+}
+
+static void modbus_txn_rx_done(struct modbus_context *ctx)
+{
+	ARG_UNUSED(ctx);
+}
+
+static void modbus_txn_flush(struct modbus_context *ctx, int err)
+{
+	ARG_UNUSED(ctx);
+	ARG_UNUSED(err);
+}
+
+static void modbus_txn_queue_init(struct modbus_context *ctx)
+{
+	ARG_UNUSED(ctx);
+}
+
+int modbus_txn_submit(struct modbus_context *ctx, struct modbus_txn *txn)
+{
+	return -ENOTSUP;
+}
+
+int modbus_txn_submit_wait(struct modbus_context *ctx,
+			   struct modbus_txn *txn)
+{
+	return -ENOTSUP;
+}
+
+int modbus_client_queue_stats(const int iface,
+			      struct modbus_queue_stats *stats)
+{
+	return -ENOTSUP;
+}
+#endif /* CONFIG_MODBUS_CLIENT */
+
 struct modbus_context *modbus_get_context(const uint8_t iface)
 {
 	struct modbus_context *ctx;
@@ -168,13 +505,8 @@ struct modbus_context *modbus_get_context(const uint8_t iface)
 
 int modbus_iface_get_by_ctx(const struct modbus_context *ctx)
 {
-	for (int i = 0; i < ARRAY_SIZE(mb_ctx_tbl); i++) {
-		if (&mb_ctx_tbl[i] == ctx) {
-			return i;
-		}
-	}
-
-	return -ENODEV;
+	/* Cached by modbus_init_iface, contexts are never moved */
+	return ctx->iface;
 }
 
 int modbus_iface_get_by_name(const char *iface_name)
@@ -204,8 +536,9 @@ static struct modbus_context *modbus_init_iface(const uint8_t iface)
 		return NULL;
 	}
 
-	k_mutex_init(&ctx->iface_lock);
-	k_sem_init(&ctx->client_wait_sem, 0, 1);
+	ctx->iface = iface;
+
+	modbus_txn_queue_init(ctx);
 	k_work_init(&ctx->server_work, modbus_rx_handler);
 
 	return ctx;
@@ -213,12 +546,17 @@ static struct modbus_context *modbus_init_iface(const uint8_t iface)
 
 static int modbus_user_fc_init(struct modbus_context *ctx, struct modbus_iface_param param)
 {
-	sys_slist_init(&ctx->user_defined_cbs);
+#ifdef CONFIG_MODBUS_SERVER
+	memset(ctx->user_fc, 0, sizeof(ctx->user_fc));
+#endif
 	LOG_DBG("Initializing user-defined function code support.");
 
 	return 0;
 }
 
+/* Callbacks of a server served by a register map or block callbacks */
+static struct modbus_user_callbacks mbs_no_user_cb;
+
 int modbus_init_server(const int iface, struct modbus_iface_param param)
 {
 	struct modbus_context *ctx = NULL;
@@ -230,12 +568,6 @@ int modbus_init_server(const int iface, struct modbus_iface_param param)
 		goto init_server_error;
 	}
 
-	if (param.server.user_cb == NULL) {
-		LOG_ERR("User callbacks should be available");
-		rc = -EINVAL;
-		goto init_server_error;
-	}
-
 	ctx = modbus_init_iface(iface);
 	if (ctx == NULL) {
 		rc = -EINVAL;
@@ -275,7 +607,8 @@ int modbus_init_server(const int iface, struct modbus_iface_param param)
 	}
 
 	ctx->unit_id = param.server.unit_id;
-	ctx->mbs_user_cb = param.server.user_cb;
+	ctx->mbs_user_cb = param.server.user_cb != NULL ?
+			   param.server.user_cb : &mbs_no_user_cb;
 	if (IS_ENABLED(CONFIG_MODBUS_FC08_DIAGNOSTIC)) {
 		modbus_reset_stats(ctx);
 	}
@@ -296,6 +629,10 @@ int modbus_register_user_fc(const int iface, struct modbus_custom_fc *custom_fc)
 {
 	struct modbus_context *ctx = modbus_get_context(iface);
 
+	if (ctx == NULL) {
+		return -EINVAL;
+	}
+
 	if (!custom_fc) {
 		LOG_ERR("Provided function code handler was NULL");
 		return -EINVAL;
@@ -306,10 +643,79 @@ int modbus_register_user_fc(const int iface, struct modbus_custom_fc *custom_fc)
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_MODBUS_SERVER
+	if (ctx->user_fc[custom_fc->fc] != NULL) {
+		LOG_ERR("Function code %u already registered", custom_fc->fc);
+		return -EALREADY;
+	}
+
 	custom_fc->excep_code = MODBUS_EXC_NONE;
 
 	LOG_DBG("Registered new custom function code %d", custom_fc->fc);
-	sys_slist_append(&ctx->user_defined_cbs, &custom_fc->node);
+	ctx->user_fc[custom_fc->fc] = custom_fc;
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int modbus_server_set_block_callbacks(const int iface,
+			const struct modbus_user_block_callbacks *cb)
+{
+	struct modbus_context *ctx = modbus_get_context(iface);
+
+	if (ctx == NULL || ctx->client) {
+		return -ENODEV;
+	}
+
+	ctx->mbs_block_cb = cb;
+
+	return 0;
+}
+
+int modbus_server_set_reg_map(const int iface, struct modbus_reg_map *map)
+{
+	struct modbus_context *ctx;
+
+	if (!IS_ENABLED(CONFIG_MODBUS_SERVER_REG_MAP)) {
+		return -ENOTSUP;
+	}
+
+	ctx = modbus_get_context(iface);
+	if (ctx == NULL || ctx->client) {
+		return -ENODEV;
+	}
+
+	ctx->mbs_reg_map = map;
+
+	return 0;
+}
+
+int modbus_server_set_device_id(const int iface,
+				const struct modbus_device_id *id)
+{
+	struct modbus_context *ctx = modbus_get_context(iface);
+
+	if (ctx == NULL || ctx->client) {
+		return -ENODEV;
+	}
+
+	/* Stream access relies on sorted objects and the basic objects */
+	for (size_t i = 0; id != NULL && i < id->num_objects; i++) {
+		if ((i < 3 && id->objects[i].id != i) ||
+		    (i > 0 && id->objects[i].id <= id->objects[i - 1].id)) {
+			LOG_ERR("Objects not sorted or basic objects missing");
+			return -EINVAL;
+		}
+	}
+
+	if (id != NULL && id->num_objects < 3) {
+		LOG_ERR("Basic objects missing");
+		return -EINVAL;
+	}
+
+	ctx->mbs_device_id = id;
 
 	return 0;
 }
@@ -361,6 +767,10 @@ int modbus_init_client(const int iface, struct modbus_iface_param param)
 	ctx->mbs_user_cb = NULL;
 	ctx->rxwait_to = param.rx_timeout;
 
+	if (IS_ENABLED(CONFIG_MODBUS_CLIENT_HEALTH)) {
+		modbus_client_health_init(ctx);
+	}
+
 	return 0;
 
 init_client_error:
@@ -386,6 +796,12 @@ int modbus_disable(const uint8_t iface)
 	case MODBUS_MODE_RTU:
 	case MODBUS_MODE_ASCII:
 		if (IS_ENABLED(CONFIG_MODBUS_SERIAL)) {
+			/* Hand the UART back powered, a later init configures it */
+			if (atomic_test_bit(&ctx->state,
+					    MODBUS_STATE_SUSPENDED)) {
+				(void)modbus_serial_resume(ctx);
+			}
+
 			modbus_serial_disable(ctx);
 		}
 		break;
@@ -396,12 +812,165 @@ int modbus_disable(const uint8_t iface)
 	}
 
 	k_work_cancel_sync(&ctx->server_work, &work_sync);
+	if (ctx->client) {
+		modbus_txn_flush(ctx, -ECANCELED);
+	}
+
 	ctx->rxwait_to = 0;
 	ctx->unit_id = 0;
 	ctx->mbs_user_cb = NULL;
+	ctx->mbs_block_cb = NULL;
+	ctx->mbs_reg_map = NULL;
+	ctx->mbs_device_id = NULL;
+	atomic_clear_bit(&ctx->state, MODBUS_STATE_SUSPENDED);
 	atomic_clear_bit(&ctx->state, MODBUS_STATE_CONFIGURED);
 
 	LOG_INF("Modbus interface %u disabled", iface);
 
 	return 0;
 }
+
+/*
+ * Suspend and resume run on the Modbus work queue, serialized with the
+ * start of client transactions, so that no frame is sent on a line that
+ * is being powered down.
+ */
+struct modbus_pm_req {
+	struct k_work work;
+	struct k_sem done;
+	struct modbus_context *ctx;
+	bool suspend;
+	int err;
+};
+
+static int modbus_iface_do_suspend(struct modbus_context *ctx)
+{
+	int err;
+
+	if (atomic_test_and_set_bit(&ctx->state, MODBUS_STATE_SUSPENDED)) {
+		return -EALREADY;
+	}
+
+#ifdef CONFIG_MODBUS_CLIENT
+	if (ctx->client && ctx->txn_active != NULL) {
+		atomic_clear_bit(&ctx->state, MODBUS_STATE_SUSPENDED);
+		return -EBUSY;
+	}
+#endif
+
+	err = modbus_serial_suspend(ctx);
+	if (err != 0) {
+		modbus_serial_rx_enable(ctx);
+		atomic_clear_bit(&ctx->state, MODBUS_STATE_SUSPENDED);
+		return err;
+	}
+
+	return 0;
+}
+
+static int modbus_iface_do_resume(struct modbus_context *ctx)
+{
+	int err;
+
+	if (!atomic_test_bit(&ctx->state, MODBUS_STATE_SUSPENDED)) {
+		return -EALREADY;
+	}
+
+	err = modbus_serial_resume(ctx);
+	if (err != 0) {
+		return err;
+	}
+
+	atomic_clear_bit(&ctx->state, MODBUS_STATE_SUSPENDED);
+
+	if (ctx->client) {
+		modbus_txn_start(ctx);
+	}
+
+	return 0;
+}
+
+static void modbus_pm_handler(struct k_work *item)
+{
+	struct modbus_pm_req *req = CONTAINER_OF(item, struct modbus_pm_req,
+						 work);
+
+	if (req->suspend) {
+		req->err = modbus_iface_do_suspend(req->ctx);
+	} else {
+		req->err = modbus_iface_do_resume(req->ctx);
+	}
+
+	k_sem_give(&req->done);
+}
+
+static int modbus_pm_run(struct modbus_context *ctx, bool suspend)
+{
+	struct modbus_pm_req req = {
+		.ctx = ctx,
+		.suspend = suspend,
+	};
+	int err;
+
+	if (k_current_get() == k_work_queue_thread_get(modbus_work_queue())) {
+		return suspend ? modbus_iface_do_suspend(ctx) :
+				 modbus_iface_do_resume(ctx);
+	}
+
+	k_work_init(&req.work, modbus_pm_handler);
+	k_sem_init(&req.done, 0, 1);
+
+	err = modbus_work_submit(&req.work);
+	if (err < 0) {
+		LOG_ERR("Failed to queue power state change (%d)", err);
+		return err;
+	}
+
+	k_sem_take(&req.done, K_FOREVER);
+
+	return req.err;
+}
+
+int modbus_iface_suspend(const int iface)
+{
+	struct modbus_context *ctx;
+	int err;
+
+	ctx = modbus_get_context(iface);
+	if (ctx == NULL) {
+		return -ENODEV;
+	}
+
+	if (!IS_ENABLED(CONFIG_MODBUS_SERIAL) || ctx->mode == MODBUS_MODE_RAW) {
+		return -ENOTSUP;
+	}
+
+	err = modbus_pm_run(ctx, true);
+	if (err != 0) {
+		return err;
+	}
+
+	LOG_DBG("Modbus interface %u suspended", iface);
+
+	return 0;
+}
+
+int modbus_iface_resume(const int iface)
+{
+	struct modbus_context *ctx;
+	int err;
+
+	ctx = modbus_get_context(iface);
+	if (ctx == NULL) {
+		return -ENODEV;
+	}
+
+	err = modbus_pm_run(ctx, false);
+	if (err != 0) {
+		return err;
+	}
+
+	LOG_DBG("Modbus interface %u resumed", iface);
+
+	return 0;
+}
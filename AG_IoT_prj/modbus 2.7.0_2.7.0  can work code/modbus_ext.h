@@ -0,0 +1,676 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @brief Extensions to the Modbus API
+ * @defgroup modbus_ext Modbus API extensions
+ * @ingroup modbus
+ * @{
+ *
+ * Functions of this header are provided by the Modbus stack of this
+ * directory in addition to the API declared in <zephyr/modbus/modbus.h>.
+ */
+
+#ifndef ZEPHYR_INCLUDE_MODBUS_EXT_H_
+#define ZEPHYR_INCLUDE_MODBUS_EXT_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/modbus/modbus.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct modbus_txn;
+
+/**
+ * @brief Client transaction queue statistics.
+ */
+struct modbus_queue_stats {
+	/** Number of transactions waiting for the bus */
+	uint32_t depth;
+	/** Highest number of transactions waiting for the bus */
+	uint32_t depth_max;
+	/** Number of transactions put on the bus */
+	uint32_t started;
+	/** Number of submissions rejected because the queue was full */
+	uint32_t rejected;
+	/** Accumulated time transactions waited for the bus, in microseconds */
+	uint64_t wait_total;
+	/** Longest time a transaction waited for the bus, in microseconds */
+	uint32_t wait_max;
+};
+
+/**
+ * @brief Client transaction completion callback.
+ *
+ * Called from the Modbus work queue when the response of the transaction
+ * has been received and validated, or when the transaction has failed.
+ *
+ * @param iface      Modbus interface index
+ * @param txn        Completed transaction
+ * @param err        0 on success, negative error code on failure or
+ *                   positive Modbus exception code reported by the server,
+ *                   -EHOSTDOWN if the server is considered down
+ */
+typedef void (*modbus_txn_cb_t)(const int iface, struct modbus_txn *txn,
+				int err);
+
+/**
+ * @brief Modbus client transaction.
+ *
+ * Storage of a request submitted with one of the modbus_submit_*
+ * functions. Members @a cb, @a signal and @a user_data are set by the
+ * caller before submission. The transaction and the buffer passed along
+ * with it belong to the stack until completion and must not be modified
+ * or reused before then.
+ */
+struct modbus_txn {
+	/** Completion callback, may be NULL */
+	modbus_txn_cb_t cb;
+	/** Poll signal raised with the result on completion, may be NULL */
+	struct k_poll_signal *signal;
+	/** User data, not used by the stack */
+	void *user_data;
+	/** Result of the transaction, valid after completion */
+	int err;
+
+	/* Members below are internal to the stack */
+	void *data;
+	const void *wr_data;
+	uint16_t addr;
+	uint16_t num;
+	uint16_t wr_addr;
+	uint16_t wr_num;
+	uint8_t unit_id;
+	uint8_t fc;
+	uint8_t flags;
+};
+
+/**
+ * @brief Coil read (FC01) without waiting for the response.
+ *
+ * Same as @ref modbus_read_coils, but the function returns as soon as the
+ * request is queued. The result is reported through @a txn.
+ *
+ * @param iface      Modbus interface index
+ * @param unit_id    Modbus unit ID of the server
+ * @param start_addr Coil starting address
+ * @param coil_tbl   Pointer to an array of bytes containing the value
+ *                   of the coils read, valid until completion
+ * @param num_coils  Quantity of coils to read
+ * @param txn        Transaction storage
+ *
+ * @retval           0 If the request was queued,
+ *                   -ENODEV if the interface is not a configured client,
+ *                   -ENOBUFS if the request does not fit into an ADU,
+ *                   -EBUSY if the transaction queue of the interface
+ *                   is full.
+ */
+int modbus_submit_read_coils(const int iface,
+			     const uint8_t unit_id,
+			     const uint16_t start_addr,
+			     uint8_t *const coil_tbl,
+			     const uint16_t num_coils,
+			     struct modbus_txn *txn);
+
+/**
+ * @brief Read discrete inputs (FC02) without waiting for the response.
+ *
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_read_dinputs(const int iface,
+			       const uint8_t unit_id,
+			       const uint16_t start_addr,
+			       uint8_t *const di_tbl,
+			       const uint16_t num_di,
+			       struct modbus_txn *txn);
+
+/**
+ * @brief Read holding registers (FC03) without waiting for the response.
+ *
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_read_holding_regs(const int iface,
+				    const uint8_t unit_id,
+				    const uint16_t start_addr,
+				    uint16_t *const reg_buf,
+				    const uint16_t num_regs,
+				    struct modbus_txn *txn);
+
+/**
+ * @brief Read input registers (FC04) without waiting for the response.
+ *
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_read_input_regs(const int iface,
+				  const uint8_t unit_id,
+				  const uint16_t start_addr,
+				  uint16_t *const reg_buf,
+				  const uint16_t num_regs,
+				  struct modbus_txn *txn);
+
+/**
+ * @brief Write single coil (FC05) without waiting for the response.
+ *
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_write_coil(const int iface,
+			     const uint8_t unit_id,
+			     const uint16_t coil_addr,
+			     const bool coil_state,
+			     struct modbus_txn *txn);
+
+/**
+ * @brief Write single holding register (FC06) without waiting for the
+ *        response.
+ *
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_write_holding_reg(const int iface,
+				    const uint8_t unit_id,
+				    const uint16_t start_addr,
+				    const uint16_t reg_val,
+				    struct modbus_txn *txn);
+
+/**
+ * @brief Write coils (FC15) without waiting for the response.
+ *
+ * The coil table is copied into the transaction queue and can be reused
+ * once the function returns.
+ *
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_write_coils(const int iface,
+			      const uint8_t unit_id,
+			      const uint16_t start_addr,
+			      uint8_t *const coil_tbl,
+			      const uint16_t num_coils,
+			      struct modbus_txn *txn);
+
+/**
+ * @brief Write holding registers (FC16) without waiting for the response.
+ *
+ * The register buffer is copied into the transaction queue and can be
+ * reused once the function returns.
+ *
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_write_holding_regs(const int iface,
+				     const uint8_t unit_id,
+				     const uint16_t start_addr,
+				     uint16_t *const reg_buf,
+				     const uint16_t num_regs,
+				     struct modbus_txn *txn);
+
+/**
+ * @brief Read/Write multiple registers (FC23).
+ *
+ * Writes holding registers and reads holding registers back in a single
+ * transaction. The server performs the write before the read.
+ *
+ * @param iface      Modbus interface index
+ * @param unit_id    Modbus unit ID of the server
+ * @param rd_addr    Address of the first register to read
+ * @param rd_buf     Buffer for the registers read
+ * @param rd_num     Quantity of registers to read, 1 to 125
+ * @param wr_addr    Address of the first register to write
+ * @param wr_buf     Values of the registers to write
+ * @param wr_num     Quantity of registers to write, 1 to 121
+ *
+ * @retval           0 If the function was successful,
+ *                   -EINVAL if a quantity is out of range,
+ *                   other errors of modbus_read_holding_regs.
+ */
+int modbus_read_write_holding_regs(const int iface,
+				   const uint8_t unit_id,
+				   const uint16_t rd_addr,
+				   uint16_t *const rd_buf,
+				   const uint16_t rd_num,
+				   const uint16_t wr_addr,
+				   const uint16_t *const wr_buf,
+				   const uint16_t wr_num);
+
+/**
+ * @brief Read/Write multiple registers (FC23) without waiting for the
+ *        response.
+ *
+ * The write buffer is copied into the transaction queue and can be
+ * reused once the function returns.
+ *
+ * @see modbus_read_write_holding_regs
+ * @see modbus_submit_read_coils
+ */
+int modbus_submit_read_write_holding_regs(const int iface,
+					  const uint8_t unit_id,
+					  const uint16_t rd_addr,
+					  uint16_t *const rd_buf,
+					  const uint16_t rd_num,
+					  const uint16_t wr_addr,
+					  const uint16_t *const wr_buf,
+					  const uint16_t wr_num,
+					  struct modbus_txn *txn);
+
+/**
+ * @brief Record group of a file record access (FC20, FC21).
+ *
+ * Files hold up to 10000 records of one register each.
+ */
+struct modbus_file_record {
+	/** File number, 1 to 0xFFFF */
+	uint16_t file;
+	/** Number of the first record, 0 to 9999 */
+	uint16_t record;
+	/** Number of records */
+	uint16_t num;
+	/** Register values of the records */
+	uint16_t *regs;
+};
+
+/**
+ * @brief Read file record (FC20).
+ *
+ * Reads several record groups in one transaction. The response to all
+ * groups has to fit into one ADU.
+ *
+ * @param iface      Modbus interface index
+ * @param unit_id    Modbus unit ID of the server
+ * @param recs       Record groups, their registers are filled in
+ * @param num_recs   Number of record groups
+ *
+ * @retval           0 If the function was successful,
+ *                   -EINVAL if a group is invalid,
+ *                   -ENOBUFS if request or response do not fit into
+ *                   an ADU, other errors of modbus_read_holding_regs.
+ */
+int modbus_read_file_records(const int iface,
+			     const uint8_t unit_id,
+			     struct modbus_file_record *const recs,
+			     const uint8_t num_recs);
+
+/**
+ * @brief Write file record (FC21).
+ *
+ * @see modbus_read_file_records
+ */
+int modbus_write_file_records(const int iface,
+			      const uint8_t unit_id,
+			      const struct modbus_file_record *const recs,
+			      const uint8_t num_recs);
+
+/**
+ * @brief State of a bulk file transfer.
+ *
+ * Set @a file, @a record, @a regs and @a num, and @a done to 0 before
+ * the first call to modbus_read_file or modbus_write_file.
+ */
+struct modbus_file_xfer {
+	/** File number */
+	uint16_t file;
+	/** Number of the first record of the transfer */
+	uint16_t record;
+	/** Register values */
+	uint16_t *regs;
+	/** Number of registers to transfer */
+	uint16_t num;
+	/** Number of registers transferred so far */
+	uint16_t done;
+};
+
+/**
+ * @brief Read a range of records of a file in as few transactions as the
+ *        ADU size allows.
+ *
+ * Every transaction transfers as many records as fit into one ADU. On
+ * failure, @a done of the transfer tells how far it got, and calling the
+ * function again with the same transfer resumes from there.
+ *
+ * @param iface      Modbus interface index
+ * @param unit_id    Modbus unit ID of the server
+ * @param xfer       Transfer state
+ *
+ * @retval           0 If all records were transferred,
+ *                   -EINVAL if the range exceeds the file,
+ *                   other errors of modbus_read_file_records.
+ */
+int modbus_read_file(const int iface, const uint8_t unit_id,
+		     struct modbus_file_xfer *const xfer);
+
+/**
+ * @brief Write a range of records of a file.
+ *
+ * @see modbus_read_file
+ */
+int modbus_write_file(const int iface, const uint8_t unit_id,
+		      struct modbus_file_xfer *const xfer);
+
+/**
+ * @brief Read device identification codes (FC43/14).
+ */
+enum modbus_device_id_code {
+	/** Stream access to the basic objects 0x00 to 0x02 */
+	MODBUS_DEVICE_ID_BASIC = 1,
+	/** Stream access to the objects 0x00 to 0x7F */
+	MODBUS_DEVICE_ID_REGULAR = 2,
+	/** Stream access to all objects */
+	MODBUS_DEVICE_ID_EXTENDED = 3,
+	/** Access to one specific object */
+	MODBUS_DEVICE_ID_SPECIFIC = 4,
+};
+
+/**
+ * @brief Device identification object.
+ */
+struct modbus_device_id_object {
+	/** Object ID, 0 VendorName, 1 ProductCode, 2 MajorMinorRevision,
+	 *  3 to 6 regular and 0x80 to 0xFF extended objects
+	 */
+	uint8_t id;
+	/** Length of the value */
+	uint8_t len;
+	/** Value, usually an ASCII string without terminator */
+	const void *value;
+};
+
+/**
+ * @brief Device identification of a server.
+ */
+struct modbus_device_id {
+	/** Objects sorted by ascending ID, objects 0 to 2 are mandatory */
+	const struct modbus_device_id_object *objects;
+	/** Number of objects */
+	size_t num_objects;
+};
+
+/**
+ * @brief Part of a device identification read by modbus_read_device_id.
+ *
+ * Set @a buf and @a size before the call.
+ */
+struct modbus_device_id_chunk {
+	/** Objects read, each as ID, length and value bytes */
+	uint8_t *buf;
+	/** Size of @a buf */
+	uint16_t size;
+	/** Number of bytes of @a buf used */
+	uint16_t len;
+	/** Number of objects in @a buf */
+	uint8_t num_objects;
+	/** Conformity level of the server */
+	uint8_t conformity;
+	/** More objects follow, read them starting with @a next_id */
+	bool more;
+	/** Object ID to continue with */
+	uint8_t next_id;
+};
+
+/**
+ * @brief Read device identification (FC43/14).
+ *
+ * Reads the objects of one response. The server sends as many objects as
+ * fit into one ADU. While @a more of the chunk is set, call the function
+ * again with @a next_id of the chunk to stream the remaining objects.
+ *
+ * @param iface      Modbus interface index
+ * @param unit_id    Modbus unit ID of the server
+ * @param code       Read device ID code
+ * @param object_id  First object to read
+ * @param chunk      Objects read
+ *
+ * @retval           0 If the function was successful,
+ *                   -EINVAL if the code or the chunk is invalid,
+ *                   -ENOBUFS if the objects do not fit into the buffer
+ *                   of the chunk, other errors of
+ *                   modbus_read_holding_regs.
+ */
+int modbus_read_device_id(const int iface,
+			  const uint8_t unit_id,
+			  const enum modbus_device_id_code code,
+			  const uint8_t object_id,
+			  struct modbus_device_id_chunk *const chunk);
+
+/**
+ * @brief Set the device identification of a server interface.
+ *
+ * Enables FC43/14 on the interface. The identification must stay valid
+ * while it is set. A custom handler registered for FC43 with
+ * modbus_register_user_fc() takes precedence, as it does for FC20, FC21
+ * and FC23.
+ *
+ * @param iface      Modbus interface index
+ * @param id         Device identification, NULL to disable FC43/14
+ *
+ * @retval           0 If the function was successful,
+ *                   -EINVAL if the objects are not sorted by ID or
+ *                   objects 0 to 2 are missing,
+ *                   -ENODEV if the interface is not a configured server.
+ */
+int modbus_server_set_device_id(const int iface,
+				const struct modbus_device_id *id);
+
+/**
+ * @brief Get client transaction queue statistics.
+ *
+ * The average time a transaction waited for the bus is
+ * wait_total / started.
+ *
+ * @param iface      Modbus interface index
+ * @param stats      Pointer to the statistics to fill
+ *
+ * @retval           0 If the function was successful,
+ *                   -ENODEV if the interface is not a configured client.
+ */
+int modbus_client_queue_stats(const int iface,
+			      struct modbus_queue_stats *stats);
+
+/**
+ * @brief Power down a serial interface between uses.
+ *
+ * Releases the DE and RE lines of the transceiver and suspends the UART
+ * through its device power management. The interface configuration is
+ * kept. Client transactions submitted while the interface is suspended
+ * stay queued until it is resumed. The interface is suspended on the
+ * Modbus work queue, between client transactions, and the call blocks
+ * until it is done.
+ *
+ * @param iface      Modbus interface index
+ *
+ * @retval           0 If the function was successful,
+ *                   -ENODEV if the interface is not configured,
+ *                   -ENOTSUP if the interface is not a serial line,
+ *                   -EALREADY if the interface is already suspended,
+ *                   -EBUSY if a client transaction is on the bus,
+ *                   other negative error code if the UART failed
+ *                   to suspend.
+ */
+int modbus_iface_suspend(const int iface);
+
+/**
+ * @brief Power up a serial interface suspended by modbus_iface_suspend.
+ *
+ * Resumes the UART and enables the receiver of the transceiver.
+ *
+ * @param iface      Modbus interface index
+ *
+ * @retval           0 If the function was successful,
+ *                   -ENODEV if the interface is not configured,
+ *                   -EALREADY if the interface is not suspended,
+ *                   other negative error code if the UART failed
+ *                   to resume.
+ */
+int modbus_iface_resume(const int iface);
+
+/**
+ * @brief Modbus server register block callbacks.
+ *
+ * Optional callbacks accessing a range of objects at once, used by the
+ * server instead of the per-object callbacks of
+ * struct modbus_user_callbacks whenever they are set. Coils and discrete
+ * inputs are packed eight per byte, the object at @a addr in bit 0 of
+ * the first byte. Registers are in CPU byte order.
+ *
+ * A callback returns 0 on success or a negative error code if any
+ * object of the range is not available, which is reported to the client
+ * as an illegal data address.
+ */
+struct modbus_user_block_callbacks {
+	/** Read @a num coils into @a coils, zeroed by the caller */
+	int (*coils_rd)(uint16_t addr, uint16_t num, uint8_t *coils);
+	/** Write @a num coils, the bits beyond @a num are undefined */
+	int (*coils_wr)(uint16_t addr, uint16_t num, const uint8_t *coils);
+	/** Read @a num discrete inputs into @a inputs, zeroed by the caller */
+	int (*discrete_inputs_rd)(uint16_t addr, uint16_t num,
+				  uint8_t *inputs);
+	/** Read @a num input registers */
+	int (*input_regs_rd)(uint16_t addr, uint16_t num, uint16_t *regs);
+	/** Read @a num holding registers */
+	int (*holding_regs_rd)(uint16_t addr, uint16_t num, uint16_t *regs);
+	/** Write @a num holding registers */
+	int (*holding_regs_wr)(uint16_t addr, uint16_t num,
+			       const uint16_t *regs);
+	/** Read @a num registers of file @a file from record @a record */
+	int (*file_record_rd)(uint16_t file, uint16_t record, uint16_t num,
+			      uint16_t *regs);
+	/** Write @a num registers of file @a file from record @a record */
+	int (*file_record_wr)(uint16_t file, uint16_t record, uint16_t num,
+			      const uint16_t *regs);
+};
+
+/**
+ * @brief Set the register block callbacks of a server interface.
+ *
+ * Floating-point registers are still accessed through the per-register
+ * callbacks.
+ *
+ * @param iface      Modbus interface index
+ * @param cb         Block callbacks, NULL to only use the per-object
+ *                   callbacks again
+ *
+ * @retval           0 If the function was successful,
+ *                   -ENODEV if the interface is not a configured server.
+ */
+int modbus_server_set_block_callbacks(const int iface,
+			const struct modbus_user_block_callbacks *cb);
+
+/**
+ * @brief Object types of a Modbus server.
+ */
+enum modbus_reg_type {
+	MODBUS_REG_COIL,
+	MODBUS_REG_DISCRETE_INPUT,
+	MODBUS_REG_INPUT,
+	MODBUS_REG_HOLDING,
+	MODBUS_REG_TYPES,
+};
+
+/**
+ * @brief Register map write hook.
+ *
+ * Called from the Modbus work queue after a client wrote a range of
+ * coils or holding registers, with the lock of the map released.
+ *
+ * @param type       MODBUS_REG_COIL or MODBUS_REG_HOLDING
+ * @param addr       Address of the first object written
+ * @param num        Number of objects written
+ * @param user_data  User data of the map
+ */
+typedef void (*modbus_reg_map_write_cb_t)(enum modbus_reg_type type,
+					  uint16_t addr, uint16_t num,
+					  void *user_data);
+
+/**
+ * @brief Area of a register map.
+ */
+struct modbus_reg_area {
+	/**
+	 * Objects of the area, coils and discrete inputs packed eight per
+	 * byte, the object at @a base in bit 0 of the first byte, registers
+	 * as an array of uint16_t in CPU byte order. NULL if not mapped.
+	 */
+	void *data;
+	/** Address of the first object */
+	uint16_t base;
+	/** Number of objects */
+	uint16_t num;
+};
+
+/**
+ * @brief Modbus server register map.
+ *
+ * Storage of the objects of a server, accessed by the server without
+ * user callbacks. Requests for addresses outside the areas of the map
+ * are answered with an illegal data address exception.
+ */
+struct modbus_reg_map {
+	/** Areas indexed by object type */
+	struct modbus_reg_area area[MODBUS_REG_TYPES];
+	/** Write hook, may be NULL */
+	modbus_reg_map_write_cb_t on_write;
+	/** User data passed to the write hook */
+	void *user_data;
+	/**
+	 * Copy every range with the lock of the map held, so that a request
+	 * sees the objects updated by the application between
+	 * modbus_reg_map_lock and modbus_reg_map_unlock all at once.
+	 */
+	bool atomic;
+
+	/* Members below are internal to the stack */
+	struct k_spinlock lock;
+};
+
+/**
+ * @brief Serve the objects of a server interface from a register map.
+ *
+ * The map takes precedence over the block and per-object callbacks,
+ * except for floating-point registers. The map must stay valid while it
+ * is set.
+ *
+ * @param iface      Modbus interface index
+ * @param map        Register map, NULL to use the callbacks again
+ *
+ * @retval           0 If the function was successful,
+ *                   -ENOTSUP if CONFIG_MODBUS_SERVER_REG_MAP is disabled,
+ *                   -ENODEV if the interface is not a configured server.
+ */
+int modbus_server_set_reg_map(const int iface, struct modbus_reg_map *map);
+
+/**
+ * @brief Lock a register map against server access.
+ *
+ * Only needed for maps with @a atomic set, to update several objects
+ * at once. Keep the section short, it runs with interrupts locked.
+ *
+ * @param map        Register map
+ *
+ * @retval           Key to pass to modbus_reg_map_unlock
+ */
+static inline k_spinlock_key_t modbus_reg_map_lock(struct modbus_reg_map *map)
+{
+	return k_spin_lock(&map->lock);
+}
+
+/**
+ * @brief Unlock a register map locked by modbus_reg_map_lock.
+ *
+ * @param map        Register map
+ * @param key        Key returned by modbus_reg_map_lock
+ */
+static inline void modbus_reg_map_unlock(struct modbus_reg_map *map,
+					 k_spinlock_key_t key)
+{
+	k_spin_unlock(&map->lock, key);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ZEPHYR_INCLUDE_MODBUS_EXT_H_ */
@@ -26,6 +26,8 @@
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/modbus/modbus.h>
+#include <zephyr/sys/byteorder.h>
+#include <modbus_ext.h>
 
 #ifdef CONFIG_MODBUS_FP_EXTENSIONS
 #define MODBUS_FP_EXTENSIONS_ADDR		5000
@@ -35,6 +37,9 @@
 
 #define MODBUS_RTU_MTU				256
 
+/* Number of function codes, the MSB flags exception responses */
+#define MODBUS_FC_NUM				128
+
 /* Modbus function codes */
 #define	MODBUS_FC01_COIL_RD			1
 #define	MODBUS_FC02_DI_RD			2
@@ -45,6 +50,10 @@
 #define	MODBUS_FC08_DIAGNOSTICS			8
 #define	MODBUS_FC15_COILS_WR			15
 #define	MODBUS_FC16_HOLDING_REGS_WR		16
+#define	MODBUS_FC20_FILE_RD			20
+#define	MODBUS_FC21_FILE_WR			21
+#define	MODBUS_FC23_HOLDING_REGS_RD_WR		23
+#define	MODBUS_FC43_ENCAP_IF			43
 
 /* Diagnostic sub-function codes */
 #define MODBUS_FC08_SUBF_QUERY			0
@@ -60,20 +69,54 @@
 #define MODBUS_COIL_ON_CODE			0xFF00
 #define MODBUS_RTU_MIN_MSG_SIZE			4
 #define MODBUS_CRC16_POLY			0xA001
+#define MODBUS_CRC16_INIT			0xFFFF
 #define MODBUS_ASCII_MIN_MSG_SIZE		11
 #define MODBUS_ASCII_START_FRAME_CHAR		':'
 #define MODBUS_ASCII_END_FRAME_CHAR1		'\r'
 #define MODBUS_ASCII_END_FRAME_CHAR2		'\n'
 
+/* File record constants */
+#define MODBUS_FILE_REF_TYPE			6
+#define MODBUS_FILE_RECORD_MAX			0x270F
+/* Limit of the FC20 byte count, in requests and responses */
+#define MODBUS_FILE_RD_BYTES_MAX		0xF5
+/* Length of reference type, file number, record number and length */
+#define MODBUS_FILE_GROUP_HDR_LEN		7
+
+/* Encapsulated interface transport (FC43) constants */
+#define MODBUS_FC43_MEI_DEVICE_ID		0x0E
+#define MODBUS_FC43_MORE_FOLLOWS		0xFF
+/* MEI type, read device ID code, conformity level, more follows,
+ * next object ID and number of objects
+ */
+#define MODBUS_FC43_RSP_HDR_LEN			6
+
 /* Modbus ADU constants */
 #define MODBUS_ADU_PROTO_ID			0x0000
+#define MODBUS_ADU_DATA_SIZE			SIZEOF_FIELD(struct modbus_adu, data)
+
+/* Maximum number of registers of a read request */
+#define MODBUS_REGS_MAX				125
+/* Maximum number of registers written by FC23 */
+#define MODBUS_FC23_WR_REGS_MAX			121
+
+#define MODBUS_TXN_QUEUE_DEPTH			CONFIG_MODBUS_CLIENT_QUEUE_DEPTH
+
+/* Client transaction flags */
+#define MODBUS_TXN_FLAG_RAW			BIT(0)
+#define MODBUS_TXN_FLAG_FP			BIT(1)
+#define MODBUS_TXN_FLAG_PROBE			BIT(2)
+
+#define MODBUS_HEALTH_NUM_UNITS			CONFIG_MODBUS_CLIENT_HEALTH_UNITS
 
 struct modbus_serial_config {
 	/* UART device */
 	const struct device *dev;
 	/* RTU timeout (maximum inter-frame delay) */
 	uint32_t rtu_timeout;
-	/* Pointer to current position in buffer */
+	/* Transmission time of one character in microseconds */
+	uint32_t char_time;
+	/* Pointer to current position in the frame */
 	uint8_t *uart_buf_ptr;
 	/* Pointer to driver enable (DE) pin config */
 	struct gpio_dt_spec *de;
@@ -81,13 +124,69 @@ struct modbus_serial_config {
 	struct gpio_dt_spec *re;
 	/* RTU timer to detect frame end point */
 	struct k_timer rtu_timer;
+#ifdef CONFIG_MODBUS_SERIAL_RTU_COUNTER
+	/* RTU timeout in counter ticks */
+	uint32_t rtu_timeout_ticks;
+	/* Counter channel used to detect frame end point */
+	uint8_t rtu_counter_chan;
+#endif
+	/* Transmission time of one character in cycles */
+	uint32_t char_time_cyc;
+	/* Maximum inter-character delay (t1.5) plus RX latency in cycles */
+	uint32_t rtu_char_timeout_cyc;
+	/* Cycle count at the last received character */
+	uint32_t rx_char_cyc;
+	/* Received frame has a gap longer than t1.5 */
+	bool rx_gap_err;
+	/* CRC16 of the characters received so far */
+	uint16_t rx_crc;
 	/* Number of bytes received or to send */
 	uint16_t uart_buf_ctr;
-	/* Storage of received characters or characters to send */
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
+	/* Reception is requested, restart it when disabled by the driver */
+	bool rx_req;
+	/* Second RX buffer, discards the characters beyond the frame size */
+	uint8_t rx_overrun_buf[8];
+#endif
+#ifdef CONFIG_MODBUS_ASCII_MODE
+	/*
+	 * Storage of received characters or characters to send in ASCII
+	 * mode, RTU frames are kept in the RX and TX ADUs of the context.
+	 */
 	uint8_t uart_buf[CONFIG_MODBUS_BUFFER_SIZE];
+#endif
 };
 
 #define MODBUS_STATE_CONFIGURED		0
+#define MODBUS_STATE_SUSPENDED		1
+
+struct modbus_unit_health {
+	/* Unit ID of the server, 0 if the entry is unused */
+	uint8_t unit_id;
+	/* Unit does not answer, requests fail without using the bus */
+	bool down;
+	/* Probe transaction is queued */
+	bool probe_pending;
+	/* Number of consecutive response timeouts */
+	uint8_t timeouts;
+	/* Number of latency samples, saturated */
+	uint8_t samples;
+	/* Smoothed server latency and its mean deviation in microseconds */
+	uint32_t srtt;
+	uint32_t rttvar;
+	/* Probe transaction of a unit that is down */
+	struct modbus_txn probe;
+	uint16_t probe_data;
+};
+
+struct modbus_txn_slot {
+	/* Transaction of the slot, NULL while free or being encoded */
+	struct modbus_txn *txn;
+	/* Cycle count at submission */
+	uint32_t submit_cyc;
+	/* Encoded request */
+	struct modbus_adu adu;
+};
 
 struct modbus_context {
 	/* Interface name */
@@ -106,13 +205,47 @@ struct modbus_context {
 	uint32_t rxwait_to;
 	/* Pointer to user server callbacks */
 	struct modbus_user_callbacks *mbs_user_cb;
+	/* Pointer to user server register block callbacks, may be NULL */
+	const struct modbus_user_block_callbacks *mbs_block_cb;
+	/* Server register map, may be NULL */
+	struct modbus_reg_map *mbs_reg_map;
+	/* Server device identification, may be NULL */
+	const struct modbus_device_id *mbs_device_id;
 	/* Interface state */
 	atomic_t state;
 
-	/* Client's mutually exclusive access */
-	struct k_mutex iface_lock;
-	/* Wait for response semaphore */
-	struct k_sem client_wait_sem;
+#ifdef CONFIG_MODBUS_CLIENT
+	/* Protects the client transaction queue */
+	struct k_spinlock txn_lock;
+	/* Counts free slots of the client transaction queue */
+	struct k_sem txn_free;
+	/* Ring of client transactions waiting for the bus */
+	struct modbus_txn_slot txn_slot[MODBUS_TXN_QUEUE_DEPTH];
+	/* Next slot to transmit */
+	uint8_t txn_head;
+	/* Next slot to fill */
+	uint8_t txn_tail;
+	/* Number of slots holding a transaction */
+	uint8_t txn_depth;
+	/* Queue statistics, wait times in cycles */
+	struct modbus_queue_stats txn_stats;
+	/* Client transaction waiting for its response */
+	struct modbus_txn *txn_active;
+	/* Work item starting the next client transaction */
+	struct k_work txn_work;
+	/* Client response timeout */
+	struct k_work_delayable txn_timeout_work;
+	/* Cycle count at the start of the active client transaction */
+	uint32_t txn_start_cyc;
+#endif
+#ifdef CONFIG_MODBUS_CLIENT_HEALTH
+	/* Response latency and state of the servers */
+	struct modbus_unit_health health[MODBUS_HEALTH_NUM_UNITS];
+	/* Next health entry to reuse */
+	uint8_t health_next;
+	/* Probes servers that are down */
+	struct k_work_delayable health_probe_work;
+#endif
 	/* Server work item */
 	struct k_work server_work;
 	/* Received frame */
@@ -130,13 +263,38 @@ struct modbus_context {
 	uint16_t mbs_server_msg_ctr;
 	uint16_t mbs_noresp_ctr;
 #endif
-	/* A linked list of function code, handler pairs */
-	sys_slist_t user_defined_cbs;
+#ifdef CONFIG_MODBUS_SERVER
+	/* User-defined function code handlers indexed by function code */
+	struct modbus_custom_fc *user_fc[MODBUS_FC_NUM];
+	/* Register values exchanged with the block callbacks */
+	uint16_t mbs_regs[MODBUS_REGS_MAX];
+#endif
 	/* Unit ID */
 	uint8_t unit_id;
+	/* Interface index */
+	uint8_t iface;
 
 };
 
+/**
+ * @brief Get the work queue processing frames and client transactions.
+ *
+ * @retval           Dedicated Modbus work queue if CONFIG_MODBUS_WORKQ is
+ *                   enabled, system work queue otherwise.
+ */
+struct k_work_q *modbus_work_queue(void);
+
+static inline int modbus_work_submit(struct k_work *work)
+{
+	return k_work_submit_to_queue(modbus_work_queue(), work);
+}
+
+static inline int modbus_work_schedule(struct k_work_delayable *dwork,
+				       k_timeout_t delay)
+{
+	return k_work_schedule_for_queue(modbus_work_queue(), dwork, delay);
+}
+
 /**
  * @brief Get Modbus interface context.
  *
@@ -164,17 +322,85 @@ int modbus_iface_get_by_ctx(const struct modbus_context *ctx);
 void modbus_tx_adu(struct modbus_context *ctx);
 
 /**
- * @brief Send ADU and wait certain time for response.
+ * @brief Queue client transaction.
  *
  * @param ctx        Modbus interface context
+ * @param txn        Transaction with request parameters set
+ *
+ * @retval           0 If the transaction was queued,
+ *                   -EBUSY if the transaction queue is full.
+ */
+int modbus_txn_submit(struct modbus_context *ctx, struct modbus_txn *txn);
+
+/**
+ * @brief Queue client transaction and wait for its completion.
+ *
+ * @param ctx        Modbus interface context
+ * @param txn        Transaction with request parameters set
  *
  * @retval           0 If the function was successful,
- *                   -ENOTSUP if Modbus mode is not supported,
+ *                   -EDEADLK if called from the Modbus work queue,
  *                   -ETIMEDOUT on timeout,
  *                   -EMSGSIZE on length error,
- *                   -EIO on CRC error.
+ *                   -EIO on CRC error,
+ *                   other errors of the transaction.
+ */
+int modbus_txn_submit_wait(struct modbus_context *ctx,
+			   struct modbus_txn *txn);
+
+/**
+ * @brief Encode the request of a client transaction.
+ *
+ * The caller has to make sure that the request fits into the ADU.
+ *
+ * @param txn        Client transaction
+ * @param adu        ADU to put the request into
+ */
+void modbus_client_txn_encode(struct modbus_txn *txn, struct modbus_adu *adu);
+
+/**
+ * @brief Initialize client health tracking.
+ *
+ * @param ctx        Modbus interface context
+ */
+void modbus_client_health_init(struct modbus_context *ctx);
+
+/**
+ * @brief Check the unit of the TX ADU before the transaction starts.
+ *
+ * @param ctx        Modbus interface context
+ * @param txn        Client transaction
+ * @param timeout    Response timeout in microseconds, set to the
+ *                   adaptive timeout of the unit
+ *
+ * @retval           0 If the transaction can be sent,
+ *                   -EHOSTDOWN if the unit is down.
+ */
+int modbus_client_health_admit(struct modbus_context *ctx,
+			       struct modbus_txn *txn, uint32_t *timeout);
+
+/**
+ * @brief Account the result of the finished client transaction.
+ *
+ * @param ctx        Modbus interface context
+ * @param txn        Client transaction
+ * @param err        Result of the transaction
  */
-int modbus_tx_wait_rx_adu(struct modbus_context *ctx);
+void modbus_client_health_update(struct modbus_context *ctx,
+				 struct modbus_txn *txn, int err);
+
+/**
+ * @brief Validate the response of a client transaction in the RX ADU.
+ *
+ * @param ctx        Modbus interface context
+ * @param txn        Client transaction
+ *
+ * @retval           0 If the function was successful,
+ *                   positive exception code returned by the server,
+ *                   negative error value otherwise.
+ */
+int modbus_client_txn_decode(struct modbus_context *ctx,
+			     struct modbus_txn *txn);
 
 /**
  * @brief Let server handle the received ADU.
@@ -186,6 +412,71 @@ int modbus_tx_wait_rx_adu(struct modbus_context *ctx);
  */
 bool modbus_server_handler(struct modbus_context *ctx);
 
+/**
+ * @brief Put registers into a frame, one pass over the whole range that
+ *        the compiler can vectorize.
+ *
+ * @param dst        Frame payload
+ * @param regs       Registers in CPU byte order
+ * @param num        Number of registers
+ */
+static inline void modbus_regs_put_be(uint8_t *dst, const uint16_t *regs,
+				      uint16_t num)
+{
+	for (uint16_t i = 0; i < num; i++) {
+		sys_put_be16(regs[i], &dst[i * sizeof(uint16_t)]);
+	}
+}
+
+/**
+ * @brief Get registers from a frame.
+ *
+ * @param regs       Registers in CPU byte order
+ * @param src        Frame payload
+ * @param num        Number of registers
+ */
+static inline void modbus_regs_get_be(uint16_t *regs, const uint8_t *src,
+				      uint16_t num)
+{
+	for (uint16_t i = 0; i < num; i++) {
+		regs[i] = sys_get_be16(&src[i * sizeof(uint16_t)]);
+	}
+}
+
+/**
+ * @brief Read a range of the server register map.
+ *
+ * @param map        Register map
+ * @param type       Object type
+ * @param addr       Address of the first object
+ * @param num        Number of objects
+ * @param dst        Frame payload, coils and inputs packed eight per byte,
+ *                   registers in big-endian byte order
+ *
+ * @retval           0 If the function was successful,
+ *                   -EINVAL if the range is not mapped.
+ */
+int modbus_reg_map_read(struct modbus_reg_map *map, enum modbus_reg_type type,
+			uint16_t addr, uint16_t num, uint8_t *dst);
+
+/**
+ * @brief Write a range of the server register map.
+ *
+ * Calls the write hook of the map on success.
+ *
+ * @param map        Register map
+ * @param type       MODBUS_REG_COIL or MODBUS_REG_HOLDING
+ * @param addr       Address of the first object
+ * @param num        Number of objects
+ * @param src        Frame payload, in the format of modbus_reg_map_read
+ *
+ * @retval           0 If the function was successful,
+ *                   -EINVAL if the range is not mapped.
+ */
+int modbus_reg_map_write(struct modbus_reg_map *map,
+			 enum modbus_reg_type type,
+			 uint16_t addr, uint16_t num, const uint8_t *src);
+
 /**
  * @brief Reset server stats.
  *
@@ -193,6 +484,21 @@ bool modbus_server_handler(struct modbus_context *ctx);
  */
 void modbus_reset_stats(struct modbus_context *ctx);
 
+/**
+ * @brief Compute Modbus RTU CRC16.
+ *
+ * Calculation can be split over several calls by passing the result of
+ * the previous call as @p crc. The CRC over a frame including its
+ * received CRC field is zero.
+ *
+ * @param crc        MODBUS_CRC16_INIT or CRC of the preceding data
+ * @param src        Input bytes
+ * @param len        Number of input bytes
+ *
+ * @retval           CRC16 value
+ */
+uint16_t modbus_crc16(uint16_t crc, const uint8_t *src, size_t len);
+
 /**
  * @brief Disable serial line reception.
  *
@@ -247,6 +553,28 @@ int modbus_serial_init(struct modbus_context *ctx,
  */
 void modbus_serial_disable(struct modbus_context *ctx);
 
+/**
+ * @brief Power down the serial line.
+ *
+ * Releases the DE and RE lines of the transceiver and suspends the UART.
+ *
+ * @param ctx        Modbus interface context
+ *
+ * @retval           0 If the function was successful,
+ *                   negative error code of the PM action otherwise.
+ */
+int modbus_serial_suspend(struct modbus_context *ctx);
+
+/**
+ * @brief Power up the serial line suspended by modbus_serial_suspend.
+ *
+ * @param ctx        Modbus interface context
+ *
+ * @retval           0 If the function was successful,
+ *                   negative error code of the PM action otherwise.
+ */
+int modbus_serial_resume(struct modbus_context *ctx);
+
 int modbus_raw_rx_adu(struct modbus_context *ctx);
 int modbus_raw_tx_adu(struct modbus_context *ctx);
 int modbus_raw_init(struct modbus_context *ctx,
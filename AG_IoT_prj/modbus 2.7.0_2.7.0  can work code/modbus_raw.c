@@ -71,7 +71,7 @@ int modbus_raw_submit_rx(const int iface, const struct modbus_adu *adu)
 	ctx->rx_adu.fc = adu->fc;
 	memcpy(ctx->rx_adu.data, adu->data,
 	       MIN(adu->length, sizeof(ctx->rx_adu.data)));
-	k_work_submit(&ctx->server_work);
+	modbus_work_submit(&ctx->server_work);
 
 	return 0;
 }
@@ -121,6 +121,10 @@ void modbus_raw_set_server_failure(struct modbus_adu *adu)
 
 int modbus_raw_backend_txn(const int iface, struct modbus_adu *adu)
 {
+	struct modbus_txn txn = {
+		.data = adu,
+		.flags = MODBUS_TXN_FLAG_RAW,
+	};
 	struct modbus_context *ctx;
 	int err;
 
@@ -143,22 +147,9 @@ int modbus_raw_backend_txn(const int iface, struct modbus_adu *adu)
 	}
 
 	LOG_DBG("Use backend interface %d", iface);
-	memcpy(&ctx->tx_adu, adu, sizeof(struct modbus_adu));
-	err = modbus_tx_wait_rx_adu(ctx);
-
-	if (err == 0) {
-		/*
-		 * Serial line does not use transaction and protocol IDs.
-		 * Temporarily store transaction and protocol IDs, and write it
-		 * back if the transfer was successful.
-		 */
-		uint16_t trans_id = adu->trans_id;
-		uint16_t proto_id = adu->proto_id;
-
-		memcpy(adu, &ctx->rx_adu, sizeof(struct modbus_adu));
-		adu->trans_id = trans_id;
-		adu->proto_id = proto_id;
-	} else {
+	err = modbus_txn_submit_wait(ctx, &txn);
+
+	if (err != 0) {
 		modbus_set_exception(adu, MODBUS_EXC_GW_TARGET_FAILED_TO_RESP);
 	}
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/sys/byteorder.h>
+#include <modbus_internal.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(modbus_map, CONFIG_MODBUS_LOG_LEVEL);
+
+static int reg_map_area_get(struct modbus_reg_map *map,
+			    enum modbus_reg_type type,
+			    uint16_t addr, uint16_t num,
+			    const struct modbus_reg_area **area)
+{
+	const struct modbus_reg_area *a = &map->area[type];
+
+	if (a->data == NULL || addr < a->base ||
+	    (uint32_t)addr - a->base + num > a->num) {
+		LOG_DBG("Range %u+%u of type %u not mapped", addr, num, type);
+		return -EINVAL;
+	}
+
+	*area = a;
+
+	return 0;
+}
+
+/*
+ * Copy bits starting at bit offset @p off of @p src to the packed frame
+ * payload, one byte at a time.
+ */
+static void reg_map_bits_get(uint8_t *dst, const uint8_t *src, uint32_t off,
+			     uint16_t num)
+{
+	const uint8_t *p = &src[off / 8];
+	uint8_t shift = off % 8;
+	uint16_t num_bytes = DIV_ROUND_UP(num, 8);
+
+	for (uint16_t i = 0; i < num_bytes; i++) {
+		uint8_t val = p[i] >> shift;
+
+		/* Remaining bits of the byte come from the next one */
+		if (shift != 0 && i * 8 + 8 - shift < num) {
+			val |= p[i + 1] << (8 - shift);
+		}
+
+		dst[i] = val;
+	}
+
+	/* Unused bits of the last byte are zero (Modbus spec 6.1) */
+	if ((num % 8) != 0) {
+		dst[num_bytes - 1] &= BIT_MASK(num % 8);
+	}
+}
+
+static void reg_map_bits_put(uint8_t *dst, uint32_t off, const uint8_t *src,
+			     uint16_t num)
+{
+	for (uint16_t i = 0; i < num; i++) {
+		uint32_t bit = off + i;
+
+		WRITE_BIT(dst[bit / 8], bit % 8, src[i / 8] & BIT(i % 8));
+	}
+}
+
+static void reg_map_area_read(const struct modbus_reg_area *area,
+			      enum modbus_reg_type type, uint32_t off,
+			      uint16_t num, uint8_t *dst)
+{
+	if (type == MODBUS_REG_COIL || type == MODBUS_REG_DISCRETE_INPUT) {
+		reg_map_bits_get(dst, area->data, off, num);
+	} else {
+		modbus_regs_put_be(dst, (uint16_t *)area->data + off, num);
+	}
+}
+
+static void reg_map_area_write(const struct modbus_reg_area *area,
+			       enum modbus_reg_type type, uint32_t off,
+			       uint16_t num, const uint8_t *src)
+{
+	if (type == MODBUS_REG_COIL) {
+		reg_map_bits_put(area->data, off, src, num);
+	} else {
+		modbus_regs_get_be((uint16_t *)area->data + off, src, num);
+	}
+}
+
+int modbus_reg_map_read(struct modbus_reg_map *map, enum modbus_reg_type type,
+			uint16_t addr, uint16_t num, uint8_t *dst)
+{
+	const struct modbus_reg_area *area;
+	uint32_t off;
+	int err;
+
+	err = reg_map_area_get(map, type, addr, num, &area);
+	if (err != 0) {
+		return err;
+	}
+
+	off = addr - area->base;
+
+	if (map->atomic) {
+		k_spinlock_key_t key = k_spin_lock(&map->lock);
+
+		reg_map_area_read(area, type, off, num, dst);
+		k_spin_unlock(&map->lock, key);
+	} else {
+		reg_map_area_read(area, type, off, num, dst);
+	}
+
+	return 0;
+}
+
+int modbus_reg_map_write(struct modbus_reg_map *map,
+			 enum modbus_reg_type type,
+			 uint16_t addr, uint16_t num, const uint8_t *src)
+{
+	const struct modbus_reg_area *area;
+	uint32_t off;
+	int err;
+
+	if (type != MODBUS_REG_COIL && type != MODBUS_REG_HOLDING) {
+		return -EINVAL;
+	}
+
+	err = reg_map_area_get(map, type, addr, num, &area);
+	if (err != 0) {
+		return err;
+	}
+
+	off = addr - area->base;
+
+	if (map->atomic) {
+		k_spinlock_key_t key = k_spin_lock(&map->lock);
+
+		reg_map_area_write(area, type, off, num, src);
+		k_spin_unlock(&map->lock, key);
+	} else {
+		reg_map_area_write(area, type, off, num, src);
+	}
+
+	if (map->on_write != NULL) {
+		map->on_write(type, addr, num, map->user_data);
+	}
+
+	return 0;
+}
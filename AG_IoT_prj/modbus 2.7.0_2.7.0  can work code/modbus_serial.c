@@ -26,9 +26,56 @@ LOG_MODULE_REGISTER(modbus_serial, LOG_LEVEL_DBG);
 #include <zephyr/kernel.h>
 #include <string.h>
 #include <zephyr/sys/byteorder.h>
-#include <zephyr/sys/crc.h>
+#include <zephyr/pm/device.h>
 #include <modbus_internal.h>
 
+#ifdef CONFIG_MODBUS_SERIAL_RTU_COUNTER
+#include <zephyr/drivers/counter.h>
+
+static const struct device *const rtu_counter =
+	DEVICE_DT_GET(DT_CHOSEN(zephyr_modbus_rtu_timer));
+#endif
+
+/*
+ * RTU frames are received into and sent from the ADU itself. Unit ID,
+ * function code, data and CRC fields of struct modbus_adu are contiguous
+ * and large enough for the longest frame.
+ */
+#define MODBUS_RTU_FRAME_OFFSET	offsetof(struct modbus_adu, unit_id)
+
+BUILD_ASSERT(offsetof(struct modbus_adu, fc) == MODBUS_RTU_FRAME_OFFSET + 1);
+BUILD_ASSERT(offsetof(struct modbus_adu, data) == MODBUS_RTU_FRAME_OFFSET + 2);
+BUILD_ASSERT(offsetof(struct modbus_adu, crc) ==
+	     offsetof(struct modbus_adu, data) +
+	     sizeof(((struct modbus_adu *)0)->data));
+BUILD_ASSERT(sizeof(struct modbus_adu) - MODBUS_RTU_FRAME_OFFSET >=
+	     CONFIG_MODBUS_BUFFER_SIZE);
+
+static inline uint8_t *modbus_rtu_frame(struct modbus_adu *adu)
+{
+	return (uint8_t *)adu + MODBUS_RTU_FRAME_OFFSET;
+}
+
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
+/*
+ * Start reception into the remaining space of the frame. While the
+ * previous reception is still being disabled, the UART driver refuses
+ * with -EBUSY and the restart is deferred to the UART_RX_DISABLED event.
+ */
+static void modbus_serial_async_rx_enable(struct modbus_context *ctx)
+{
+	struct modbus_serial_config *cfg = ctx->cfg;
+	int err;
+
+	err = uart_rx_enable(cfg->dev, cfg->uart_buf_ptr,
+			     CONFIG_MODBUS_BUFFER_SIZE - cfg->uart_buf_ctr,
+			     cfg->rtu_timeout);
+	if (err != 0 && err != -EBUSY) {
+		LOG_ERR("Failed to enable UART RX (%d)", err);
+	}
+}
+#endif
+
 static void modbus_serial_tx_on(struct modbus_context *ctx)
 {
 	struct modbus_serial_config *cfg = ctx->cfg;
@@ -37,14 +84,23 @@ static void modbus_serial_tx_on(struct modbus_context *ctx)
 		gpio_pin_set(cfg->de->port, cfg->de->pin, 1);
 	}
 
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
+	if (uart_tx(cfg->dev, cfg->uart_buf_ptr, cfg->uart_buf_ctr,
+		    SYS_FOREVER_US) != 0) {
+		LOG_ERR("Failed to start UART TX");
+	}
+#else
 	uart_irq_tx_enable(cfg->dev);
+#endif
 }
 
 static void modbus_serial_tx_off(struct modbus_context *ctx)
 {
 	struct modbus_serial_config *cfg = ctx->cfg;
 
+#ifndef CONFIG_MODBUS_SERIAL_ASYNC
 	uart_irq_tx_disable(cfg->dev);
+#endif
 	if (cfg->de != NULL) {
 		gpio_pin_set(cfg->de->port, cfg->de->pin, 0);
 	}
@@ -58,19 +114,72 @@ static void modbus_serial_rx_on(struct modbus_context *ctx)
 		gpio_pin_set(cfg->re->port, cfg->re->pin, 1);
 	}
 
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
+	cfg->rx_req = true;
+	modbus_serial_async_rx_enable(ctx);
+#else
 	uart_irq_rx_enable(cfg->dev);
+#endif
 }
 
 static void modbus_serial_rx_off(struct modbus_context *ctx)
 {
 	struct modbus_serial_config *cfg = ctx->cfg;
 
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
+	cfg->rx_req = false;
+	(void)uart_rx_disable(cfg->dev);
+#else
 	uart_irq_rx_disable(cfg->dev);
+#endif
 	if (cfg->re != NULL) {
 		gpio_pin_set(cfg->re->port, cfg->re->pin, 0);
 	}
 }
 
+#ifdef CONFIG_MODBUS_SERIAL_RTU_COUNTER
+static void rtu_counter_handler(const struct device *dev, uint8_t chan,
+				uint32_t ticks, void *user_data)
+{
+	struct modbus_context *ctx = (struct modbus_context *)user_data;
+
+	modbus_work_submit(&ctx->server_work);
+}
+#endif
+
+/* (Re)start the t3.5 timer detecting the end of the RTU frame. */
+static void modbus_rtu_timer_start(struct modbus_context *ctx)
+{
+	struct modbus_serial_config *cfg = ctx->cfg;
+
+#ifdef CONFIG_MODBUS_SERIAL_RTU_COUNTER
+	struct counter_alarm_cfg alarm = {
+		.callback = rtu_counter_handler,
+		.ticks = cfg->rtu_timeout_ticks,
+		.user_data = ctx,
+	};
+
+	(void)counter_cancel_channel_alarm(rtu_counter, cfg->rtu_counter_chan);
+	if (counter_set_channel_alarm(rtu_counter, cfg->rtu_counter_chan,
+				      &alarm) != 0) {
+		LOG_ERR("Failed to set RTU counter alarm");
+	}
+#else
+	k_timer_start(&cfg->rtu_timer, K_USEC(cfg->rtu_timeout), K_NO_WAIT);
+#endif
+}
+
+static void modbus_rtu_timer_stop(struct modbus_context *ctx)
+{
+	struct modbus_serial_config *cfg = ctx->cfg;
+
+#ifdef CONFIG_MODBUS_SERIAL_RTU_COUNTER
+	(void)counter_cancel_channel_alarm(rtu_counter, cfg->rtu_counter_chan);
+#else
+	k_timer_stop(&cfg->rtu_timer);
+#endif
+}
+
 #ifdef CONFIG_MODBUS_ASCII_MODE
 /* The function calculates an 8-bit Longitudinal Redundancy Check. */
 static uint8_t modbus_ascii_get_lrc(uint8_t *src, size_t length)
@@ -169,6 +278,32 @@ static int modbus_ascii_rx_adu(struct modbus_context *ctx)
 	return 0;
 }
 
+static void modbus_ascii_rx_char(struct modbus_context *ctx)
+{
+	struct modbus_serial_config *cfg = ctx->cfg;
+	uint8_t c;
+
+	if (uart_fifo_read(cfg->dev, &c, 1) != 1) {
+		LOG_ERR("Failed to read UART");
+		return;
+	}
+
+	if (c == MODBUS_ASCII_START_FRAME_CHAR) {
+		/* Restart a new frame */
+		cfg->uart_buf_ptr = &cfg->uart_buf[0];
+		cfg->uart_buf_ctr = 0;
+	}
+
+	if (cfg->uart_buf_ctr < CONFIG_MODBUS_BUFFER_SIZE) {
+		*cfg->uart_buf_ptr++ = c;
+		cfg->uart_buf_ctr++;
+	}
+
+	if (c == MODBUS_ASCII_END_FRAME_CHAR2) {
+		modbus_work_submit(&ctx->server_work);
+	}
+}
+
 static uint8_t *modbus_ascii_bin2hex(uint8_t value, uint8_t *pbuf)
 {
 	uint8_t u_nibble = (value >> 4) & 0x0F;
@@ -237,15 +372,39 @@ static int modbus_ascii_rx_adu(struct modbus_context *ctx)
 static void modbus_ascii_tx_adu(struct modbus_context *ctx)
 {
 }
+
+static void modbus_ascii_rx_char(struct modbus_context *ctx)
+{
+}
 #endif
 
-/* Copy Modbus RTU frame and check if the CRC is valid. */
+/* Prepare the buffer for the reception of a new frame. */
+static void modbus_serial_rx_reset(struct modbus_context *ctx)
+{
+	struct modbus_serial_config *cfg = ctx->cfg;
+
+	cfg->uart_buf_ctr = 0;
+	cfg->rx_crc = MODBUS_CRC16_INIT;
+	cfg->rx_gap_err = false;
+
+#ifdef CONFIG_MODBUS_ASCII_MODE
+	if (ctx->mode == MODBUS_MODE_ASCII) {
+		cfg->uart_buf_ptr = &cfg->uart_buf[0];
+		return;
+	}
+#endif
+
+	cfg->uart_buf_ptr = modbus_rtu_frame(&ctx->rx_adu);
+}
+
+/* Check the RTU frame received in place into the RX ADU. */
 static int modbus_rtu_rx_adu(struct modbus_context *ctx)
 {
 	struct modbus_serial_config *cfg = ctx->cfg;
+	uint8_t *frame = modbus_rtu_frame(&ctx->rx_adu);
 	uint16_t calc_crc;
 	uint16_t crc_idx;
-	uint8_t *data_ptr;
+	bool crc_valid;
 
 	/* Is the message long enough? */
 	if ((cfg->uart_buf_ctr < MODBUS_RTU_MIN_MSG_SIZE) ||
@@ -254,23 +413,29 @@ static int modbus_rtu_rx_adu(struct modbus_context *ctx)
 		return -EMSGSIZE;
 	}
 
-	ctx->rx_adu.unit_id = cfg->uart_buf[0];
-	ctx->rx_adu.fc = cfg->uart_buf[1];
-	data_ptr = &cfg->uart_buf[2];
+	if (cfg->rx_gap_err) {
+		LOG_WRN("Inter-character timeout within frame");
+		return -EMSGSIZE;
+	}
+
 	/* Payload length without node address, function code, and CRC */
 	ctx->rx_adu.length = cfg->uart_buf_ctr - 4;
 	/* CRC index */
 	crc_idx = cfg->uart_buf_ctr - sizeof(uint16_t);
 
-	memcpy(ctx->rx_adu.data, data_ptr, ctx->rx_adu.length);
+	ctx->rx_adu.crc = sys_get_le16(&frame[crc_idx]);
+	LOG_HEXDUMP_DBG(frame, cfg->uart_buf_ctr, "frame");
 
-	ctx->rx_adu.crc = sys_get_le16(&cfg->uart_buf[crc_idx]);
-	/* Calculate CRC over address, function code, and payload */
-	calc_crc = crc16_ansi(&cfg->uart_buf[0],
-			      cfg->uart_buf_ctr - sizeof(ctx->rx_adu.crc));
-	LOG_HEXDUMP_DBG(cfg->uart_buf, cfg->uart_buf_ctr, "uart_buf");
-	
-	if (ctx->rx_adu.crc != calc_crc) {
+	if (IS_ENABLED(CONFIG_MODBUS_CRC_STREAMING)) {
+		/* CRC over the whole frame including the CRC field is zero */
+		crc_valid = (cfg->rx_crc == 0);
+	} else {
+		/* Calculate CRC over address, function code, and payload */
+		calc_crc = modbus_crc16(MODBUS_CRC16_INIT, frame, crc_idx);
+		crc_valid = (ctx->rx_adu.crc == calc_crc);
+	}
+
+	if (!crc_valid) {
 		LOG_WRN("Calculated CRC does not match received CRC");
 		return -EIO;
 	}
@@ -278,79 +443,147 @@ static int modbus_rtu_rx_adu(struct modbus_context *ctx)
 	return 0;
 }
 
+/* Append the CRC to the TX ADU and send it as RTU frame. */
 static void rtu_tx_adu(struct modbus_context *ctx)
 {
 	struct modbus_serial_config *cfg = ctx->cfg;
-	uint16_t tx_bytes = 0;
-	uint8_t *data_ptr;
-
-	cfg->uart_buf[0] = ctx->tx_adu.unit_id;
-	cfg->uart_buf[1] = ctx->tx_adu.fc;
-	tx_bytes = 2 + ctx->tx_adu.length;
-	data_ptr = &cfg->uart_buf[2];
-
-	memcpy(data_ptr, ctx->tx_adu.data, ctx->tx_adu.length);
+	uint8_t *frame = modbus_rtu_frame(&ctx->tx_adu);
+	uint16_t tx_bytes = 2 + ctx->tx_adu.length;
 
-	ctx->tx_adu.crc = crc16_ansi(&cfg->uart_buf[0], ctx->tx_adu.length + 2);
-	sys_put_le16(ctx->tx_adu.crc,
-		     &cfg->uart_buf[ctx->tx_adu.length + 2]);
+	ctx->tx_adu.crc = modbus_crc16(MODBUS_CRC16_INIT, frame, tx_bytes);
+	sys_put_le16(ctx->tx_adu.crc, &frame[tx_bytes]);
 	tx_bytes += 2;
 
 	cfg->uart_buf_ctr = tx_bytes;
-	cfg->uart_buf_ptr = &cfg->uart_buf[0];
+	cfg->uart_buf_ptr = frame;
 
-	LOG_HEXDUMP_DBG(cfg->uart_buf, cfg->uart_buf_ctr, "uart_buf");
+	LOG_HEXDUMP_DBG(frame, cfg->uart_buf_ctr, "frame");
 	LOG_DBG("Start frame transmission");
 	modbus_serial_rx_off(ctx);
 	modbus_serial_tx_on(ctx);
 }
 
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
 /*
- * A byte has been received from a serial port. We just store it in the buffer
- * for processing when a complete packet has been received.
+ * Characters of the RTU frame have been received. The UART driver reports
+ * them after the RX timeout, set to the inter-frame delay, or when the
+ * buffer is full. Only in the latter case the frame end is unknown and the
+ * RTU timer is used to detect it.
  */
-static void cb_handler_rx(struct modbus_context *ctx)
+static void modbus_serial_async_rx_rdy(struct modbus_context *ctx,
+				       struct uart_event_rx *rx)
 {
 	struct modbus_serial_config *cfg = ctx->cfg;
 
-	if ((ctx->mode == MODBUS_MODE_ASCII) &&
-	    IS_ENABLED(CONFIG_MODBUS_ASCII_MODE)) {
-		uint8_t c;
+	if (!cfg->rx_req) {
+		/* Characters flushed while the reception is disabled */
+		return;
+	}
 
-		if (uart_fifo_read(cfg->dev, &c, 1) != 1) {
-			LOG_ERR("Failed to read UART");
-			return;
-		}
+	if (rx->buf == cfg->rx_overrun_buf) {
+		/* Frame does not fit into the ADU, let the length check fail */
+		cfg->uart_buf_ctr = CONFIG_MODBUS_BUFFER_SIZE + 1;
+		modbus_rtu_timer_start(ctx);
+		return;
+	}
 
-		if (c == MODBUS_ASCII_START_FRAME_CHAR) {
-			/* Restart a new frame */
-			cfg->uart_buf_ptr = &cfg->uart_buf[0];
-			cfg->uart_buf_ctr = 0;
-		}
+	if (IS_ENABLED(CONFIG_MODBUS_CRC_STREAMING)) {
+		cfg->rx_crc = modbus_crc16(cfg->rx_crc, &rx->buf[rx->offset],
+					   rx->len);
+	}
 
-		if (cfg->uart_buf_ctr < CONFIG_MODBUS_BUFFER_SIZE) {
-			*cfg->uart_buf_ptr++ = c;
-			cfg->uart_buf_ctr++;
-		}
+	cfg->uart_buf_ptr += rx->len;
+	cfg->uart_buf_ctr += rx->len;
+
+	if (cfg->uart_buf_ctr < CONFIG_MODBUS_BUFFER_SIZE) {
+		modbus_rtu_timer_stop(ctx);
+		modbus_work_submit(&ctx->server_work);
+	} else {
+		modbus_rtu_timer_start(ctx);
+	}
+}
+
+static void uart_async_cb_handler(const struct device *dev,
+				  struct uart_event *evt, void *user_data)
+{
+	struct modbus_context *ctx = (struct modbus_context *)user_data;
+	struct modbus_serial_config *cfg;
+
+	if (ctx == NULL) {
+		LOG_ERR("Modbus hardware is not properly initialized");
+		return;
+	}
 
-		if (c == MODBUS_ASCII_END_FRAME_CHAR2) {
-			k_work_submit(&ctx->server_work);
+	cfg = ctx->cfg;
+
+	switch (evt->type) {
+	case UART_TX_DONE:
+	case UART_TX_ABORTED:
+		modbus_serial_rx_reset(ctx);
+		modbus_serial_tx_off(ctx);
+		modbus_serial_rx_on(ctx);
+		break;
+	case UART_RX_RDY:
+		modbus_serial_async_rx_rdy(ctx, &evt->data.rx);
+		break;
+	case UART_RX_BUF_REQUEST:
+		/* Second buffer keeps the reception running on overrun */
+		uart_rx_buf_rsp(dev, cfg->rx_overrun_buf,
+				sizeof(cfg->rx_overrun_buf));
+		break;
+	case UART_RX_DISABLED:
+		if (cfg->rx_req) {
+			modbus_serial_async_rx_enable(ctx);
 		}
+		break;
+	default:
+		break;
+	}
+}
+#else
+/*
+ * A byte has been received from a serial port. We just store it in the buffer
+ * for processing when a complete packet has been received.
+ */
+static void cb_handler_rx(struct modbus_context *ctx)
+{
+	struct modbus_serial_config *cfg = ctx->cfg;
 
+	if ((ctx->mode == MODBUS_MODE_ASCII) &&
+	    IS_ENABLED(CONFIG_MODBUS_ASCII_MODE)) {
+		modbus_ascii_rx_char(ctx);
 	} else {
+		uint32_t now = k_cycle_get_32();
 		int n;
 
 		/* Restart timer on a new character */
 		n = uart_fifo_read(cfg->dev, cfg->uart_buf_ptr,
 				   (CONFIG_MODBUS_BUFFER_SIZE -
 				    cfg->uart_buf_ctr));
-		k_timer_start(&cfg->rtu_timer,
-			      K_USEC(cfg->rtu_timeout), K_NO_WAIT);
+		modbus_rtu_timer_start(ctx);
+
+		/*
+		 * Characters must not be separated by more than t1.5. The time
+		 * since the last interrupt includes the transmission of the
+		 * characters read now.
+		 */
+		if (cfg->uart_buf_ctr > 0 && n > 0 &&
+		    (now - cfg->rx_char_cyc) >
+		    (n * cfg->char_time_cyc + cfg->rtu_char_timeout_cyc)) {
+			cfg->rx_gap_err = true;
+		}
+
+		cfg->rx_char_cyc = now;
 
 		// n = uart_fifo_read(cfg->dev, cfg->uart_buf_ptr,
 		// 		   (CONFIG_MODBUS_BUFFER_SIZE -
 		// 		    cfg->uart_buf_ctr));
 
+		if (IS_ENABLED(CONFIG_MODBUS_CRC_STREAMING) && n > 0) {
+			cfg->rx_crc = modbus_crc16(cfg->rx_crc,
+						   cfg->uart_buf_ptr, n);
+		}
+
 		cfg->uart_buf_ptr += n;
 		cfg->uart_buf_ctr += n;
 	}
@@ -375,7 +608,7 @@ static void cb_handler_tx(struct modbus_context *ctx)
 	 */
 	if (uart_irq_tx_complete(cfg->dev)) {
 		/* Disable transmission */
-		cfg->uart_buf_ptr = &cfg->uart_buf[0];
+		modbus_serial_rx_reset(ctx);
 		modbus_serial_tx_off(ctx);
 		modbus_serial_rx_on(ctx);
 	}
@@ -405,6 +638,8 @@ static void uart_cb_handler(const struct device *dev, void *app_data)
 	}
 }
 
+#endif
+
 /* This function is called when the RTU framing timer expires. */
 static void rtu_tmr_handler(struct k_timer *t_id)
 {
@@ -417,7 +652,7 @@ static void rtu_tmr_handler(struct k_timer *t_id)
 		return;
 	}
 
-	k_work_submit(&ctx->server_work);
+	modbus_work_submit(&ctx->server_work);
 }
 
 static int configure_gpio(struct modbus_context *ctx)
@@ -531,8 +766,7 @@ int modbus_serial_rx_adu(struct modbus_context *ctx)
 		return -ENOTSUP;
 	}
 
-	cfg->uart_buf_ctr = 0;
-	cfg->uart_buf_ptr = &cfg->uart_buf[0];
+	modbus_serial_rx_reset(ctx);
 
 	return rc;
 }
@@ -560,7 +794,9 @@ int modbus_serial_init(struct modbus_context *ctx,
 {
 	struct modbus_serial_config *cfg = ctx->cfg;
 	const uint32_t if_delay_max = 3500000;
+	const uint32_t ic_delay_max = 1500000;
 	const uint32_t numof_bits = 11;
+	uint32_t rtu_char_timeout;
 
 	switch (param.mode) {
 	case MODBUS_MODE_RTU:
@@ -585,30 +821,116 @@ int modbus_serial_init(struct modbus_context *ctx,
 	if (param.serial.baud <= 38400) {
 		cfg->rtu_timeout = (numof_bits * if_delay_max) /
 				   param.serial.baud;
+		rtu_char_timeout = (numof_bits * ic_delay_max) /
+				   param.serial.baud;
 	} else {
 		cfg->rtu_timeout = (numof_bits * if_delay_max) / 38400;
+		rtu_char_timeout = (numof_bits * ic_delay_max) / 38400;
 	}
 
+	cfg->char_time = (numof_bits * 1000000) / param.serial.baud;
+#ifndef CONFIG_MODBUS_SERIAL_ASYNC
+	cfg->char_time_cyc = k_us_to_cyc_floor32(cfg->char_time);
+	cfg->rtu_char_timeout_cyc = k_us_to_cyc_ceil32(rtu_char_timeout +
+				CONFIG_MODBUS_SERIAL_RTU_RX_LATENCY);
+#endif
+
+#ifdef CONFIG_MODBUS_SERIAL_RTU_COUNTER
+	if (!device_is_ready(rtu_counter)) {
+		LOG_ERR("RTU counter %s is not ready", rtu_counter->name);
+		return -ENODEV;
+	}
+
+	/* Serial interfaces come first, use the interface index as channel */
+	cfg->rtu_counter_chan = modbus_iface_get_by_ctx(ctx);
+	if (cfg->rtu_counter_chan >= counter_get_num_of_channels(rtu_counter)) {
+		LOG_ERR("No RTU counter channel for interface %u",
+			cfg->rtu_counter_chan);
+		return -ENOTSUP;
+	}
+
+	cfg->rtu_timeout_ticks = counter_us_to_ticks(rtu_counter,
+						     cfg->rtu_timeout);
+	counter_start(rtu_counter);
+#endif
+
 	if (configure_gpio(ctx) != 0) {
 		return -EIO;
 	}
 
-	cfg->uart_buf_ctr = 0;
-	cfg->uart_buf_ptr = &cfg->uart_buf[0];
+	modbus_serial_rx_reset(ctx);
 
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
+	if (uart_callback_set(cfg->dev, uart_async_cb_handler, ctx) != 0) {
+		LOG_ERR("UART asynchronous API not supported");
+		return -ENOTSUP;
+	}
+#else
 	uart_irq_callback_user_data_set(cfg->dev, uart_cb_handler, ctx);
+#endif
 	k_timer_init(&cfg->rtu_timer, rtu_tmr_handler, NULL);
 	k_timer_user_data_set(&cfg->rtu_timer, ctx);
 
 	modbus_serial_rx_on(ctx);
-	LOG_INF("RTU timeout %u us", cfg->rtu_timeout);
+	LOG_INF("RTU timeout %u us, inter-character timeout %u us",
+		cfg->rtu_timeout, rtu_char_timeout);
 
 	return 0;
 }
 
 void modbus_serial_disable(struct modbus_context *ctx)
 {
+#ifdef CONFIG_MODBUS_SERIAL_ASYNC
+	(void)uart_tx_abort(ctx->cfg->dev);
+#endif
 	modbus_serial_tx_off(ctx);
 	modbus_serial_rx_off(ctx);
-	k_timer_stop(&ctx->cfg->rtu_timer);
+	modbus_rtu_timer_stop(ctx);
+}
+
+/* A UART without power management support stays powered */
+static int modbus_serial_pm_action(struct modbus_context *ctx,
+				   enum pm_device_action action)
+{
+	int err = 0;
+
+#ifdef CONFIG_PM_DEVICE
+	err = pm_device_action_run(ctx->cfg->dev, action);
+	if (err == -EALREADY || err == -ENOSYS) {
+		err = 0;
+	}
+#endif
+
+	return err;
+}
+
+int modbus_serial_suspend(struct modbus_context *ctx)
+{
+	int err;
+
+	modbus_serial_disable(ctx);
+
+	err = modbus_serial_pm_action(ctx, PM_DEVICE_ACTION_SUSPEND);
+	if (err != 0) {
+		LOG_ERR("Failed to suspend %s (%d)", ctx->cfg->dev->name, err);
+	}
+
+	return err;
+}
+
+int modbus_serial_resume(struct modbus_context *ctx)
+{
+	int err;
+
+	err = modbus_serial_pm_action(ctx, PM_DEVICE_ACTION_RESUME);
+	if (err != 0) {
+		LOG_ERR("Failed to resume %s (%d)", ctx->cfg->dev->name, err);
+		return err;
+	}
+
+	/* Drop whatever the line picked up while powered down */
+	modbus_serial_rx_reset(ctx);
+	modbus_serial_rx_on(ctx);
+
+	return 0;
 }
@@ -91,6 +91,75 @@ static void mbs_exception_rsp(struct modbus_context *ctx, uint8_t excep_code)
 	ctx->tx_adu.length = 1;
 }
 
+/* Block callback of the server, NULL if not set */
+#define MBS_BLOCK_CB(ctx, name) \
+	((ctx)->mbs_block_cb != NULL ? (ctx)->mbs_block_cb->name : NULL)
+
+/* Register map of the server, NULL if not set */
+#define MBS_REG_MAP(ctx) \
+	(IS_ENABLED(CONFIG_MODBUS_SERVER_REG_MAP) ? (ctx)->mbs_reg_map : NULL)
+
+/*
+ * Ranges are served at once by the register map or a block callback,
+ * in this order, before falling back to the per-object callbacks.
+ */
+#define MBS_BLOCK(ctx, name) \
+	(MBS_REG_MAP(ctx) != NULL || MBS_BLOCK_CB(ctx, name) != NULL)
+
+/* Read a range into the response payload, in the byte order of the frame */
+static int mbs_block_read(struct modbus_context *ctx,
+			  enum modbus_reg_type type,
+			  uint16_t addr, uint16_t qty, uint8_t *dst)
+{
+	const struct modbus_user_block_callbacks *cb = ctx->mbs_block_cb;
+	int err;
+
+	if (MBS_REG_MAP(ctx) != NULL) {
+		return modbus_reg_map_read(ctx->mbs_reg_map, type, addr, qty,
+					   dst);
+	}
+
+	switch (type) {
+	case MODBUS_REG_COIL:
+		return cb->coils_rd(addr, qty, dst);
+	case MODBUS_REG_DISCRETE_INPUT:
+		return cb->discrete_inputs_rd(addr, qty, dst);
+	case MODBUS_REG_INPUT:
+		err = cb->input_regs_rd(addr, qty, ctx->mbs_regs);
+		break;
+	default:
+		err = cb->holding_regs_rd(addr, qty, ctx->mbs_regs);
+		break;
+	}
+
+	if (err == 0) {
+		modbus_regs_put_be(dst, ctx->mbs_regs, qty);
+	}
+
+	return err;
+}
+
+/* Write a range of coils or holding registers from the request payload */
+static int mbs_block_write(struct modbus_context *ctx,
+			   enum modbus_reg_type type,
+			   uint16_t addr, uint16_t qty, const uint8_t *src)
+{
+	const struct modbus_user_block_callbacks *cb = ctx->mbs_block_cb;
+
+	if (MBS_REG_MAP(ctx) != NULL) {
+		return modbus_reg_map_write(ctx->mbs_reg_map, type, addr, qty,
+					    src);
+	}
+
+	if (type == MODBUS_REG_COIL) {
+		return cb->coils_wr(addr, qty, src);
+	}
+
+	modbus_regs_get_be(ctx->mbs_regs, src, qty);
+
+	return cb->holding_regs_wr(addr, qty, ctx->mbs_regs);
+}
+
 /*
  * FC 01 (0x01) Read Coils
  *
@@ -122,7 +191,8 @@ static bool mbs_fc01_coil_read(struct modbus_context *ctx)
 		return false;
 	}
 
-	if (ctx->mbs_user_cb->coil_rd == NULL) {
+	if (ctx->mbs_user_cb->coil_rd == NULL &&
+	    !MBS_BLOCK(ctx, coils_rd)) {
 		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 		return true;
 	}
@@ -150,6 +220,18 @@ static bool mbs_fc01_coil_read(struct modbus_context *ctx)
 
 	/* Reset the pointer to the start of the response payload */
 	presp = &ctx->tx_adu.data[1];
+
+	if (MBS_BLOCK(ctx, coils_rd)) {
+		err = mbs_block_read(ctx, MODBUS_REG_COIL, coil_addr,
+				     coil_qty, presp);
+		if (err != 0) {
+			LOG_INF("Coil address not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+		}
+
+		return true;
+	}
+
 	/* Start with bit 0 in response byte data mask. */
 	bit_mask = BIT(0);
 	/* Initialize loop counter. */
@@ -221,7 +303,8 @@ static bool mbs_fc02_di_read(struct modbus_context *ctx)
 		return false;
 	}
 
-	if (ctx->mbs_user_cb->discrete_input_rd == NULL) {
+	if (ctx->mbs_user_cb->discrete_input_rd == NULL &&
+	    !MBS_BLOCK(ctx, discrete_inputs_rd)) {
 		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 		return true;
 	}
@@ -251,6 +334,18 @@ static bool mbs_fc02_di_read(struct modbus_context *ctx)
 
 	/* Reset the pointer to the start of the response payload */
 	presp = &ctx->tx_adu.data[1];
+
+	if (MBS_BLOCK(ctx, discrete_inputs_rd)) {
+		err = mbs_block_read(ctx, MODBUS_REG_DISCRETE_INPUT, di_addr,
+				     di_qty, presp);
+		if (err != 0) {
+			LOG_INF("Discrete input address not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+		}
+
+		return true;
+	}
+
 	/* Start with bit 0 in response byte data mask. */
 	bit_mask = BIT(0);
 	/* Initialize loop counter. */
@@ -325,7 +420,8 @@ static bool mbs_fc03_hreg_read(struct modbus_context *ctx)
 	if ((reg_addr < MODBUS_FP_EXTENSIONS_ADDR) ||
 	    !IS_ENABLED(CONFIG_MODBUS_FP_EXTENSIONS)) {
 		/* Read integer register */
-		if (ctx->mbs_user_cb->holding_reg_rd == NULL) {
+		if (ctx->mbs_user_cb->holding_reg_rd == NULL &&
+		    !MBS_BLOCK(ctx, holding_regs_rd)) {
 			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 			return true;
 		}
@@ -360,6 +456,18 @@ static bool mbs_fc03_hreg_read(struct modbus_context *ctx)
 	/* Set number of data bytes in response message. */
 	ctx->tx_adu.data[0] = (uint8_t)num_bytes;
 
+	if (reg_addr < MODBUS_FP_EXTENSIONS_ADDR &&
+	    MBS_BLOCK(ctx, holding_regs_rd)) {
+		err = mbs_block_read(ctx, MODBUS_REG_HOLDING, reg_addr,
+				     reg_qty, &ctx->tx_adu.data[1]);
+		if (err != 0) {
+			LOG_INF("Holding register address not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+		}
+
+		return true;
+	}
+
 	/* Reset the pointer to the start of the response payload */
 	presp = &ctx->tx_adu.data[1];
 	/* Loop through each register requested. */
@@ -435,7 +543,8 @@ static bool mbs_fc04_inreg_read(struct modbus_context *ctx)
 	if ((reg_addr < MODBUS_FP_EXTENSIONS_ADDR) ||
 	    !IS_ENABLED(CONFIG_MODBUS_FP_EXTENSIONS)) {
 		/* Read integer register */
-		if (ctx->mbs_user_cb->input_reg_rd == NULL) {
+		if (ctx->mbs_user_cb->input_reg_rd == NULL &&
+		    !MBS_BLOCK(ctx, input_regs_rd)) {
 			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 			return true;
 		}
@@ -470,6 +579,18 @@ static bool mbs_fc04_inreg_read(struct modbus_context *ctx)
 	/* Set number of data bytes in response message. */
 	ctx->tx_adu.data[0] = (uint8_t)num_bytes;
 
+	if (reg_addr < MODBUS_FP_EXTENSIONS_ADDR &&
+	    MBS_BLOCK(ctx, input_regs_rd)) {
+		err = mbs_block_read(ctx, MODBUS_REG_INPUT, reg_addr,
+				     reg_qty, &ctx->tx_adu.data[1]);
+		if (err != 0) {
+			LOG_INF("Input register address not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+		}
+
+		return true;
+	}
+
 	/* Reset the pointer to the start of the response payload */
 	presp = &ctx->tx_adu.data[1];
 	/* Loop through each register requested. */
@@ -538,7 +659,8 @@ static bool mbs_fc05_coil_write(struct modbus_context *ctx)
 		return false;
 	}
 
-	if (ctx->mbs_user_cb->coil_wr == NULL) {
+	if (ctx->mbs_user_cb->coil_wr == NULL &&
+	    !MBS_BLOCK(ctx, coils_wr)) {
 		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 		return true;
 	}
@@ -554,7 +676,13 @@ static bool mbs_fc05_coil_write(struct modbus_context *ctx)
 		coil_state = true;
 	}
 
-	err = ctx->mbs_user_cb->coil_wr(coil_addr, coil_state);
+	if (MBS_BLOCK(ctx, coils_wr)) {
+		uint8_t coil = coil_state ? BIT(0) : 0;
+
+		err = mbs_block_write(ctx, MODBUS_REG_COIL, coil_addr, 1, &coil);
+	} else {
+		err = ctx->mbs_user_cb->coil_wr(coil_addr, coil_state);
+	}
 
 	if (err != 0) {
 		LOG_INF("Coil address not supported");
@@ -596,7 +724,8 @@ static bool mbs_fc06_hreg_write(struct modbus_context *ctx)
 		return false;
 	}
 
-	if (ctx->mbs_user_cb->holding_reg_wr == NULL) {
+	if (ctx->mbs_user_cb->holding_reg_wr == NULL &&
+	    !MBS_BLOCK(ctx, holding_regs_wr)) {
 		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 		return true;
 	}
@@ -604,7 +733,12 @@ static bool mbs_fc06_hreg_write(struct modbus_context *ctx)
 	reg_addr = sys_get_be16(&ctx->rx_adu.data[0]);
 	reg_val = sys_get_be16(&ctx->rx_adu.data[2]);
 
-	err = ctx->mbs_user_cb->holding_reg_wr(reg_addr, reg_val);
+	if (MBS_BLOCK(ctx, holding_regs_wr)) {
+		err = mbs_block_write(ctx, MODBUS_REG_HOLDING, reg_addr, 1,
+				      &ctx->rx_adu.data[2]);
+	} else {
+		err = ctx->mbs_user_cb->holding_reg_wr(reg_addr, reg_val);
+	}
 
 	if (err != 0) {
 		LOG_INF("Register address not supported");
@@ -740,7 +874,8 @@ static bool mbs_fc15_coils_write(struct modbus_context *ctx)
 		return false;
 	}
 
-	if (ctx->mbs_user_cb->coil_wr == NULL) {
+	if (ctx->mbs_user_cb->coil_wr == NULL &&
+	    !MBS_BLOCK(ctx, coils_wr)) {
 		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 		return true;
 	}
@@ -764,9 +899,22 @@ static bool mbs_fc15_coils_write(struct modbus_context *ctx)
 		return true;
 	}
 
-	coil_cntr = 0;
 	/* The 1st coil data byte is 6th element in payload */
 	data_ix = 5;
+
+	if (MBS_BLOCK(ctx, coils_wr)) {
+		err = mbs_block_write(ctx, MODBUS_REG_COIL, coil_addr,
+				      coil_qty, &ctx->rx_adu.data[data_ix]);
+		if (err != 0) {
+			LOG_INF("Coil address not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+			return true;
+		}
+
+		goto response;
+	}
+
+	coil_cntr = 0;
 	/* Loop through each coil to be forced. */
 	while (coil_cntr < coil_qty) {
 		/* Move to the next data byte after every eight bits. */
@@ -795,6 +943,7 @@ static bool mbs_fc15_coils_write(struct modbus_context *ctx)
 		coil_cntr++;
 	}
 
+response:
 	/* Assemble response payload */
 	ctx->tx_adu.length = response_len;
 	sys_put_be16(coil_addr, &ctx->tx_adu.data[0]);
@@ -848,7 +997,8 @@ static bool mbs_fc16_hregs_write(struct modbus_context *ctx)
 	if ((reg_addr < MODBUS_FP_EXTENSIONS_ADDR) ||
 	    !IS_ENABLED(CONFIG_MODBUS_FP_EXTENSIONS)) {
 		/* Write integer register */
-		if (ctx->mbs_user_cb->holding_reg_wr == NULL) {
+		if (ctx->mbs_user_cb->holding_reg_wr == NULL &&
+		    !MBS_BLOCK(ctx, holding_regs_wr)) {
 			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
 			return true;
 		}
@@ -892,6 +1042,19 @@ static bool mbs_fc16_hregs_write(struct modbus_context *ctx)
 	/* The 1st registers data byte is 6th element in payload */
 	prx_data = &ctx->rx_adu.data[5];
 
+	if (reg_addr < MODBUS_FP_EXTENSIONS_ADDR &&
+	    MBS_BLOCK(ctx, holding_regs_wr)) {
+		err = mbs_block_write(ctx, MODBUS_REG_HOLDING, reg_addr,
+				      reg_qty, prx_data);
+		if (err != 0) {
+			LOG_INF("Register address not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+			return true;
+		}
+
+		goto response;
+	}
+
 	for (uint16_t reg_cntr = 0; reg_cntr < reg_qty; reg_cntr++) {
 		uint16_t addr = reg_addr + reg_cntr;
 
@@ -918,6 +1081,7 @@ static bool mbs_fc16_hregs_write(struct modbus_context *ctx)
 		}
 	}
 
+response:
 	/* Assemble response payload */
 	ctx->tx_adu.length = response_len;
 	sys_put_be16(reg_addr, &ctx->tx_adu.data[0]);
@@ -926,38 +1090,536 @@ static bool mbs_fc16_hregs_write(struct modbus_context *ctx)
 	return true;
 }
 
-static bool mbs_try_user_fc(struct modbus_context *ctx, uint8_t fc)
+/*
+ * FC23 (0x17) Read/Write Multiple registers
+ *
+ * Request Payload:
+ *  Function code          1 Byte
+ *  Read Starting Address  2 Bytes
+ *  Quantity to Read       2 Bytes
+ *  Write Starting Address 2 Bytes
+ *  Quantity to Write      2 Bytes
+ *  Write Byte Count       1 Byte
+ *  Write Registers Value  N * 2 Bytes
+ *
+ * Response Payload:
+ *  Function code          1 Byte
+ *  Byte count             1 Byte
+ *  Read Registers Value   N * 2 Bytes
+ *
+ * The write is performed before the read. Floating-point registers are
+ * not supported.
+ */
+static bool mbs_fc23_hregs_rd_wr(struct modbus_context *ctx)
 {
-	struct modbus_custom_fc *p;
+	const uint8_t request_len = 9;
+	uint8_t *prx_data;
+	uint8_t *presp;
+	int err;
+	uint16_t rd_addr;
+	uint16_t rd_qty;
+	uint16_t wr_addr;
+	uint16_t wr_qty;
+	uint16_t num_bytes;
+
+	if (ctx->rx_adu.length < request_len) {
+		LOG_ERR("Wrong request length %u", ctx->rx_adu.length);
+		return false;
+	}
+
+	if ((ctx->mbs_user_cb->holding_reg_rd == NULL &&
+	     !MBS_BLOCK(ctx, holding_regs_rd)) ||
+	    (ctx->mbs_user_cb->holding_reg_wr == NULL &&
+	     !MBS_BLOCK(ctx, holding_regs_wr))) {
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
+		return true;
+	}
+
+	rd_addr = sys_get_be16(&ctx->rx_adu.data[0]);
+	rd_qty = sys_get_be16(&ctx->rx_adu.data[2]);
+	wr_addr = sys_get_be16(&ctx->rx_adu.data[4]);
+	wr_qty = sys_get_be16(&ctx->rx_adu.data[6]);
+	/* Get the byte count for the data. */
+	num_bytes = ctx->rx_adu.data[8];
+
+	if (rd_qty == 0 || rd_qty > MODBUS_REGS_MAX ||
+	    wr_qty == 0 || wr_qty > MODBUS_FC23_WR_REGS_MAX) {
+		LOG_ERR("Number of registers limit exceeded");
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+		return true;
+	}
+
+	if (num_bytes != wr_qty * sizeof(uint16_t) ||
+	    ctx->rx_adu.length != request_len + num_bytes) {
+		LOG_ERR("Mismatch in the number of bytes");
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+		return true;
+	}
+
+	if (IS_ENABLED(CONFIG_MODBUS_FP_EXTENSIONS) &&
+	    (rd_addr >= MODBUS_FP_EXTENSIONS_ADDR ||
+	     wr_addr >= MODBUS_FP_EXTENSIONS_ADDR)) {
+		LOG_INF("Floating-point registers not supported");
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+		return true;
+	}
+
+	/* The 1st registers data byte is 10th element in payload */
+	prx_data = &ctx->rx_adu.data[request_len];
+
+	if (MBS_BLOCK(ctx, holding_regs_wr)) {
+		err = mbs_block_write(ctx, MODBUS_REG_HOLDING, wr_addr, wr_qty,
+				      prx_data);
+	} else {
+		err = 0;
+		for (uint16_t i = 0; err == 0 && i < wr_qty; i++) {
+			err = ctx->mbs_user_cb->holding_reg_wr(wr_addr + i,
+				sys_get_be16(&prx_data[i * sizeof(uint16_t)]));
+		}
+	}
+
+	if (err != 0) {
+		LOG_INF("Register address not supported");
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+		return true;
+	}
+
+	presp = &ctx->tx_adu.data[1];
+
+	if (MBS_BLOCK(ctx, holding_regs_rd)) {
+		err = mbs_block_read(ctx, MODBUS_REG_HOLDING, rd_addr, rd_qty,
+				     presp);
+	} else {
+		for (uint16_t i = 0; err == 0 && i < rd_qty; i++) {
+			uint16_t reg;
+
+			err = ctx->mbs_user_cb->holding_reg_rd(rd_addr + i, &reg);
+			if (err == 0) {
+				sys_put_be16(reg, &presp[i * sizeof(uint16_t)]);
+			}
+		}
+	}
+
+	if (err != 0) {
+		LOG_INF("Holding register address not supported");
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+		return true;
+	}
+
+	/* Assemble response payload */
+	num_bytes = rd_qty * sizeof(uint16_t);
+	ctx->tx_adu.length = num_bytes + 1;
+	ctx->tx_adu.data[0] = (uint8_t)num_bytes;
+
+	return true;
+}
+
+/* Check the reference type and range of a file record group */
+static bool mbs_file_group_valid(const uint8_t *group)
+{
+	uint16_t file = sys_get_be16(&group[1]);
+	uint16_t record = sys_get_be16(&group[3]);
+	uint16_t num = sys_get_be16(&group[5]);
+
+	return group[0] == MODBUS_FILE_REF_TYPE && file != 0 &&
+	       (uint32_t)record + num - 1 <= MODBUS_FILE_RECORD_MAX;
+}
+
+/*
+ * FC20 (0x14) Read File Record
+ *
+ * Request Payload:
+ *  Function code          1 Byte
+ *  Byte Count             1 Byte
+ *  Sub-Requests           N * 7 Bytes
+ *   Reference Type        1 Byte
+ *   File Number           2 Bytes
+ *   Record Number         2 Bytes
+ *   Record Length         2 Bytes
+ *
+ * Response Payload:
+ *  Function code          1 Byte
+ *  Response Data Length   1 Byte
+ *  Sub-Responses          N * (2 + M * 2) Bytes
+ *   File Response Length  1 Byte
+ *   Reference Type        1 Byte
+ *   Record Data           M * 2 Bytes
+ */
+static bool mbs_fc20_file_read(struct modbus_context *ctx)
+{
+	const uint8_t request_len = 1;
+	const uint8_t hdr_len = MODBUS_FILE_GROUP_HDR_LEN;
+	uint8_t *preq;
+	uint8_t *presp;
+	int err;
+	uint16_t num_bytes;
+	uint16_t rsp_bytes = 0;
+
+	if (ctx->rx_adu.length < request_len) {
+		LOG_ERR("Wrong request length %u", ctx->rx_adu.length);
+		return false;
+	}
+
+	if (MBS_BLOCK_CB(ctx, file_record_rd) == NULL) {
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
+		return true;
+	}
 
-	LOG_DBG("Searching for custom Modbus handlers for code %u", fc);
+	num_bytes = ctx->rx_adu.data[0];
+	preq = &ctx->rx_adu.data[request_len];
 
-	SYS_SLIST_FOR_EACH_CONTAINER(&ctx->user_defined_cbs, p, node) {
-		if (p->fc == fc) {
-			int iface = modbus_iface_get_by_ctx(ctx);
-			bool rval;
+	if (num_bytes < hdr_len || num_bytes > MODBUS_FILE_RD_BYTES_MAX || (num_bytes % hdr_len) ||
+	    ctx->rx_adu.length != request_len + num_bytes) {
+		LOG_ERR("Wrong byte count %u", num_bytes);
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+		return true;
+	}
+
+	for (uint16_t i = 0; i < num_bytes; i += hdr_len) {
+		uint16_t num = sys_get_be16(&preq[i + 5]);
+
+		if (num == 0 || num > MODBUS_REGS_MAX) {
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+			return true;
+		}
+
+		if (!mbs_file_group_valid(&preq[i])) {
+			LOG_INF("File record not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+			return true;
+		}
+
+		rsp_bytes += 2 + num * sizeof(uint16_t);
+	}
+
+	if (request_len + rsp_bytes > MIN(sizeof(ctx->tx_adu.data),
+					  MODBUS_FILE_RD_BYTES_MAX)) {
+		LOG_ERR("Response exceeds the byte count limit");
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+		return true;
+	}
+
+	presp = &ctx->tx_adu.data[1];
+
+	for (uint16_t i = 0; i < num_bytes; i += hdr_len) {
+		uint16_t num = sys_get_be16(&preq[i + 5]);
+
+		err = ctx->mbs_block_cb->file_record_rd(sys_get_be16(&preq[i + 1]),
+							sys_get_be16(&preq[i + 3]),
+							num, ctx->mbs_regs);
+		if (err != 0) {
+			LOG_INF("File record not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+			return true;
+		}
+
+		*presp++ = 1 + num * sizeof(uint16_t);
+		*presp++ = MODBUS_FILE_REF_TYPE;
+		modbus_regs_put_be(presp, ctx->mbs_regs, num);
+		presp += num * sizeof(uint16_t);
+	}
+
+	/* Assemble response payload */
+	ctx->tx_adu.length = request_len + rsp_bytes;
+	ctx->tx_adu.data[0] = (uint8_t)rsp_bytes;
+
+	return true;
+}
+
+/*
+ * FC21 (0x15) Write File Record
+ *
+ * Request Payload:
+ *  Function code          1 Byte
+ *  Request Data Length    1 Byte
+ *  Sub-Requests           N * (7 + M * 2) Bytes
+ *   Reference Type        1 Byte
+ *   File Number           2 Bytes
+ *   Record Number         2 Bytes
+ *   Record Length         2 Bytes
+ *   Record Data           M * 2 Bytes
+ *
+ * Response Payload:
+ *  Echo of the request
+ *
+ * All groups are checked before the first one is written.
+ */
+static bool mbs_fc21_file_write(struct modbus_context *ctx)
+{
+	const uint8_t request_len = 1;
+	const uint8_t hdr_len = MODBUS_FILE_GROUP_HDR_LEN;
+	uint8_t *preq;
+	int err;
+	uint16_t num_bytes;
+	uint16_t num;
+
+	if (ctx->rx_adu.length < request_len) {
+		LOG_ERR("Wrong request length %u", ctx->rx_adu.length);
+		return false;
+	}
+
+	if (MBS_BLOCK_CB(ctx, file_record_wr) == NULL) {
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
+		return true;
+	}
+
+	num_bytes = ctx->rx_adu.data[0];
+	preq = &ctx->rx_adu.data[request_len];
+
+	if (num_bytes < hdr_len + 2 || num_bytes > 0xFB ||
+	    ctx->rx_adu.length != request_len + num_bytes) {
+		LOG_ERR("Wrong byte count %u", num_bytes);
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+		return true;
+	}
+
+	for (uint16_t i = 0; i < num_bytes; i += hdr_len + num * 2) {
+		if (i + hdr_len > num_bytes) {
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+			return true;
+		}
+
+		num = sys_get_be16(&preq[i + 5]);
+		if (num == 0 || i + hdr_len + num * 2 > num_bytes) {
+			LOG_ERR("Mismatch in the number of bytes");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+			return true;
+		}
+
+		if (!mbs_file_group_valid(&preq[i])) {
+			LOG_INF("File record not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+			return true;
+		}
+	}
+
+	for (uint16_t i = 0; i < num_bytes; i += hdr_len + num * 2) {
+		num = sys_get_be16(&preq[i + 5]);
+		modbus_regs_get_be(ctx->mbs_regs, &preq[i + hdr_len], num);
+
+		err = ctx->mbs_block_cb->file_record_wr(sys_get_be16(&preq[i + 1]),
+							sys_get_be16(&preq[i + 3]),
+							num, ctx->mbs_regs);
+		if (err != 0) {
+			LOG_INF("File record not supported");
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+			return true;
+		}
+	}
+
+	/* Assemble response payload */
+	ctx->tx_adu.length = ctx->rx_adu.length;
+	memcpy(ctx->tx_adu.data, ctx->rx_adu.data, ctx->rx_adu.length);
+
+	return true;
+}
+
+/* Conformity level, the highest category of the objects, with individual
+ * access supported
+ */
+static uint8_t mbs_device_id_conformity(const struct modbus_device_id *id)
+{
+	uint8_t last_id = id->objects[id->num_objects - 1].id;
+
+	if (last_id >= 0x80) {
+		return 0x83;
+	}
+
+	return last_id >= 0x03 ? 0x82 : 0x81;
+}
 
-			LOG_DBG("Found custom handler");
+/*
+ * FC43 (0x2B) Encapsulated Interface Transport,
+ * MEI 14 (0x0E) Read Device Identification
+ *
+ * Request Payload:
+ *  Function code          1 Byte
+ *  MEI Type               1 Byte
+ *  Read Device ID Code    1 Byte
+ *  Object Id              1 Byte
+ *
+ * Response Payload:
+ *  Function code          1 Byte
+ *  MEI Type               1 Byte
+ *  Read Device ID Code    1 Byte
+ *  Conformity Level       1 Byte
+ *  More Follows           1 Byte
+ *  Next Object Id         1 Byte
+ *  Number Of Objects      1 Byte
+ *  Objects                N * (2 + M) Bytes
+ *   Object Id             1 Byte
+ *   Object Length         1 Byte
+ *   Object Value          M Bytes
+ *
+ * Stream access sends as many objects as fit into the response and
+ * tells the client where to continue.
+ */
+static bool mbs_fc43_device_id(struct modbus_context *ctx)
+{
+	const struct modbus_device_id *id = ctx->mbs_device_id;
+	const uint8_t request_len = 3;
+	const struct modbus_device_id_object *obj;
+	uint8_t *presp;
+	uint8_t code;
+	uint8_t obj_id;
+	uint8_t last_id;
+	uint8_t num_objs = 0;
+	uint16_t length = MODBUS_FC43_RSP_HDR_LEN;
+	size_t i;
 
-			p->excep_code = MODBUS_EXC_NONE;
-			rval = p->cb(iface, &ctx->rx_adu, &ctx->tx_adu, &p->excep_code,
-					p->user_data);
+	if (ctx->rx_adu.length != request_len) {
+		LOG_ERR("Wrong request length %u", ctx->rx_adu.length);
+		return false;
+	}
+
+	if (ctx->rx_adu.data[0] != MODBUS_FC43_MEI_DEVICE_ID ||
+	    id == NULL || id->num_objects == 0) {
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
+		return true;
+	}
+
+	code = ctx->rx_adu.data[1];
+	obj_id = ctx->rx_adu.data[2];
 
-			if (p->excep_code != MODBUS_EXC_NONE) {
-				LOG_INF("Custom handler failed with code %d", p->excep_code);
-				mbs_exception_rsp(ctx, p->excep_code);
+	switch (code) {
+	case MODBUS_DEVICE_ID_BASIC:
+		last_id = 0x02;
+		break;
+	case MODBUS_DEVICE_ID_REGULAR:
+		last_id = 0x7F;
+		break;
+	case MODBUS_DEVICE_ID_EXTENDED:
+	case MODBUS_DEVICE_ID_SPECIFIC:
+		last_id = 0xFF;
+		break;
+	default:
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_VAL);
+		return true;
+	}
+
+	for (i = 0; i < id->num_objects; i++) {
+		if (id->objects[i].id == obj_id) {
+			break;
+		}
+	}
+
+	if (i == id->num_objects || obj_id > last_id) {
+		if (code == MODBUS_DEVICE_ID_SPECIFIC) {
+			LOG_INF("Object 0x%02x not supported", obj_id);
+			mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDR);
+			return true;
+		}
+
+		/* Unknown objects restart the stream at the beginning */
+		i = 0;
+	}
+
+	presp = &ctx->tx_adu.data[MODBUS_FC43_RSP_HDR_LEN];
+	ctx->tx_adu.data[3] = 0;
+	ctx->tx_adu.data[4] = 0;
+
+	for (; i < id->num_objects && id->objects[i].id <= last_id; i++) {
+		uint8_t len;
+
+		obj = &id->objects[i];
+		len = obj->len;
+
+		if (length + 2 + len > sizeof(ctx->tx_adu.data)) {
+			if (num_objs > 0) {
+				ctx->tx_adu.data[3] = MODBUS_FC43_MORE_FOLLOWS;
+				ctx->tx_adu.data[4] = obj->id;
+				break;
 			}
 
-			return rval;
+			/* An object longer than a response is truncated */
+			len = sizeof(ctx->tx_adu.data) - length - 2;
+		}
+
+		*presp++ = obj->id;
+		*presp++ = len;
+		memcpy(presp, obj->value, len);
+		presp += len;
+		length += 2 + len;
+		num_objs++;
+
+		if (code == MODBUS_DEVICE_ID_SPECIFIC) {
+			break;
 		}
 	}
 
-	LOG_ERR("Function code 0x%02x not implemented", fc);
-	mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
+	/* Assemble response payload */
+	ctx->tx_adu.length = length;
+	ctx->tx_adu.data[0] = MODBUS_FC43_MEI_DEVICE_ID;
+	ctx->tx_adu.data[1] = code;
+	ctx->tx_adu.data[2] = mbs_device_id_conformity(id);
+	ctx->tx_adu.data[5] = num_objs;
 
 	return true;
 }
 
+typedef bool (*mbs_fc_handler_t)(struct modbus_context *ctx);
+
+/* Handlers of the standard function codes, indexed by function code */
+static const mbs_fc_handler_t mbs_fc_handlers[MODBUS_FC_NUM] = {
+	[MODBUS_FC01_COIL_RD] = mbs_fc01_coil_read,
+	[MODBUS_FC02_DI_RD] = mbs_fc02_di_read,
+	[MODBUS_FC03_HOLDING_REG_RD] = mbs_fc03_hreg_read,
+	[MODBUS_FC04_IN_REG_RD] = mbs_fc04_inreg_read,
+	[MODBUS_FC05_COIL_WR] = mbs_fc05_coil_write,
+	[MODBUS_FC06_HOLDING_REG_WR] = mbs_fc06_hreg_write,
+	[MODBUS_FC08_DIAGNOSTICS] = mbs_fc08_diagnostics,
+	[MODBUS_FC15_COILS_WR] = mbs_fc15_coils_write,
+	[MODBUS_FC16_HOLDING_REGS_WR] = mbs_fc16_hregs_write,
+	[MODBUS_FC20_FILE_RD] = mbs_fc20_file_read,
+	[MODBUS_FC21_FILE_WR] = mbs_fc21_file_write,
+	[MODBUS_FC23_HOLDING_REGS_RD_WR] = mbs_fc23_hregs_rd_wr,
+	[MODBUS_FC43_ENCAP_IF] = mbs_fc43_device_id,
+};
+
+/*
+ * Applications used to serve these codes with custom handlers before the
+ * stack implemented them, a registered handler keeps precedence.
+ */
+static bool mbs_user_fc_first(uint8_t fc)
+{
+	switch (fc) {
+	case MODBUS_FC20_FILE_RD:
+	case MODBUS_FC21_FILE_WR:
+	case MODBUS_FC23_HOLDING_REGS_RD_WR:
+	case MODBUS_FC43_ENCAP_IF:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool mbs_try_user_fc(struct modbus_context *ctx, uint8_t fc)
+{
+	struct modbus_custom_fc *p;
+	bool rval;
+
+	p = fc < MODBUS_FC_NUM ? ctx->user_fc[fc] : NULL;
+	if (p == NULL) {
+		LOG_ERR("Function code 0x%02x not implemented", fc);
+		mbs_exception_rsp(ctx, MODBUS_EXC_ILLEGAL_FC);
+
+		return true;
+	}
+
+	LOG_DBG("Found custom handler for code %u", fc);
+
+	p->excep_code = MODBUS_EXC_NONE;
+	rval = p->cb(ctx->iface, &ctx->rx_adu, &ctx->tx_adu, &p->excep_code,
+		     p->user_data);
+
+	if (p->excep_code != MODBUS_EXC_NONE) {
+		LOG_INF("Custom handler failed with code %d", p->excep_code);
+		mbs_exception_rsp(ctx, p->excep_code);
+	}
+
+	return rval;
+}
+
 bool modbus_server_handler(struct modbus_context *ctx)
 {
 	bool send_reply = false;
@@ -990,44 +1652,10 @@ bool modbus_server_handler(struct modbus_context *ctx)
 
 	update_server_msg_ctr(ctx);
 
-	switch (fc) {
-	case MODBUS_FC01_COIL_RD:
-		send_reply = mbs_fc01_coil_read(ctx);
-		break;
-
-	case MODBUS_FC02_DI_RD:
-		send_reply = mbs_fc02_di_read(ctx);
-		break;
-
-	case MODBUS_FC03_HOLDING_REG_RD:
-		send_reply = mbs_fc03_hreg_read(ctx);
-		break;
-
-	case MODBUS_FC04_IN_REG_RD:
-		send_reply = mbs_fc04_inreg_read(ctx);
-		break;
-
-	case MODBUS_FC05_COIL_WR:
-		send_reply = mbs_fc05_coil_write(ctx);
-		break;
-
-	case MODBUS_FC06_HOLDING_REG_WR:
-		send_reply = mbs_fc06_hreg_write(ctx);
-		break;
-
-	case MODBUS_FC08_DIAGNOSTICS:
-		send_reply = mbs_fc08_diagnostics(ctx);
-		break;
-
-	case MODBUS_FC15_COILS_WR:
-		send_reply = mbs_fc15_coils_write(ctx);
-		break;
-
-	case MODBUS_FC16_HOLDING_REGS_WR:
-		send_reply = mbs_fc16_hregs_write(ctx);
-		break;
-
-	default:
+	if (fc < MODBUS_FC_NUM && mbs_fc_handlers[fc] != NULL &&
+	    !(mbs_user_fc_first(fc) && ctx->user_fc[fc] != NULL)) {
+		send_reply = mbs_fc_handlers[fc](ctx);
+	} else {
 		send_reply = mbs_try_user_fc(ctx, fc);
 	}
 